@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bench.h"
+
+double bench_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+char *generate_program(int size, int *generated_size) {
+    //one block is always smaller than this
+    int max_block_size = 512;
+    char *text = malloc(size + max_block_size);
+    int pos = 0;
+    int block = 0;
+    while (pos < size) {
+        pos += sprintf(text + pos,
+            "value%d = %d + 1\n"
+            "function func%d {\n"
+            "    if (value%d == 3) {\n"
+            "        value%d = value%d - 1\n"
+            "    } else {\n"
+            "        temp = value%d + value%d\n"
+            "    }\n"
+            "    value%d = value%d + 2\n"
+            "}\n"
+            "func%d()\n\n",
+            block, block, block, block, block, block, block, block, block, block, block
+        );
+        block += 1;
+    }
+    *generated_size = pos;
+    return text;
+}
+
+char *generate_commented_program(int size, int *generated_size) {
+    int max_block_size = 1024;
+    char *text = malloc(size + max_block_size);
+    int pos = 0;
+    int block = 0;
+    while (pos < size) {
+        pos += sprintf(text + pos,
+            "/*\n"
+            " * generated function number %d\n"
+            " * it increments value%d until it reaches a limit, every statement is documented\n"
+            " */\n"
+            "value%d = %d\n"
+            "\n"
+            "function func%d {\n"
+            "                // stop at the limit\n"
+            "                if (value%d != 100) {\n"
+            "                                // increment and recurse\n"
+            "                                value%d = value%d + 1\n"
+            "\n"
+            "\n"
+            "                                func%d()\n"
+            "                }\n"
+            "}\n"
+            "\n"
+            "// run it once\n"
+            "func%d()\n"
+            "\n\n",
+            block, block, block, block, block, block, block, block, block, block
+        );
+        block += 1;
+    }
+    *generated_size = pos;
+    return text;
+}
+
+char *generate_nested_program(int depth, int count, int *generated_size) {
+    //upper bound for a single level (opening and closing part)
+    int max_level_size = 96;
+    char *text = malloc((long) count * (depth + 2) * max_level_size);
+    int pos = sprintf(text, "value = 1\n");
+    for (int block = 0; block < count; block++) {
+        for (int level = 0; level < depth; level++) {
+            if (level % 2 == 0) {
+                pos += sprintf(text + pos, "function func%dn%d {\n", block, level);
+            }
+            else {
+                pos += sprintf(text + pos, "if (value != %d) {\n", level);
+            }
+        }
+        pos += sprintf(text + pos, "value = value + 1\n");
+        for (int level = depth - 1; level >= 0; level--) {
+            if (level % 2 == 0) {
+                pos += sprintf(text + pos, "}\nfunc%dn%d()\n", block, level);
+            }
+            else {
+                pos += sprintf(text + pos, "} else {\nvalue = value - 1\n}\n");
+            }
+        }
+    }
+    *generated_size = pos;
+    return text;
+}
+
+void bench_report(char *name, double bytes, double seconds) {
+    printf("%-40s %10.3f ms %10.1f MB/s\n", name, seconds * 1e3, bytes / seconds / 1e6);
+}
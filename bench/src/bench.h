@@ -0,0 +1,22 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+//monotonic wall clock time in seconds
+double bench_time();
+
+//generate a valid program of at least size bytes out of plain ASCII statements
+//(assignments, function definitions, conditions and calls with indentation)
+//the actual size is stored in generated_size, the text is not null terminated
+char *generate_program(int size, int *generated_size);
+
+//like generate_program, but most of the text is indentation, blank lines, line comments and block comments
+char *generate_commented_program(int size, int *generated_size);
+
+//generate a valid program made of count copies of a block that nests function definitions and conditions depth levels deep
+//(both alternate, so depth 4 is function { if { function { if { ... } } } })
+char *generate_nested_program(int depth, int count, int *generated_size);
+
+//print a single benchmark result as throughput (bytes per second)
+void bench_report(char *name, double bytes, double seconds);
+
+#endif
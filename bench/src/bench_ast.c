@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../../src/lexer.h"
+#include "../../src/parser.h"
+#include "../../src/flat.h"
+
+#define INPUT_SIZE (16 * 1024 * 1024)
+#define ITERATIONS 5
+
+//visit every node of the pointer based AST, like analysis and codegen used to
+static long walk_pointer_ast(AST_Node *node) {
+    long visited = 0;
+    while (node != NULL) {
+        visited += 1;
+        if (node->ms != NULL) visited += walk_pointer_ast(node->ms);
+        if (node->lhs != NULL) visited += walk_pointer_ast(node->lhs);
+        if (node->rhs != NULL) visited += walk_pointer_ast(node->rhs);
+        visited += walk_pointer_ast(node->children);
+        node = node->next;
+    }
+    return visited;
+}
+
+//same for the flat AST, subtrees are skipped with their size like analysis and codegen do
+static long walk_flat_ast(Flat_AST *ast, int node, int end) {
+    long visited = 0;
+    while (node < end) {
+        visited += 1 + walk_flat_ast(ast, node + 1, flat_end(ast, node));
+        node = flat_end(ast, node);
+    }
+    return visited;
+}
+
+int main() {
+    int size;
+    char *text = generate_program(INPUT_SIZE, &size);
+    Token_List *tokens = new_token_list();
+    if (tokenize(new_source(text, size), tokens)) {
+        printf("lexer failed\n");
+        return 1;
+    }
+    Arena *ast_arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+    AST_Node *ast = parse(tokens, ast_arena);
+    if (ast == NULL) {
+        printf("parser failed\n");
+        return 1;
+    }
+    Flat_AST *flat_ast = flatten_ast(ast, tokens);
+
+    printf("==== AST: %d bytes, %d tokens, %d nodes ====\n", size, tokens->count, flat_ast->count);
+    printf("%-40s %10.1f MB\n", "pointer AST memory", ast_arena->bytes / 1e6);
+    printf("%-40s %10.1f MB\n", "flat AST memory", flat_ast->count * sizeof(Flat_Node) / 1e6);
+
+    double pointer_best = 0, flat_best = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        double start = bench_time();
+        long pointer_visited = walk_pointer_ast(ast);
+        double pointer_seconds = bench_time() - start;
+
+        start = bench_time();
+        long flat_visited = walk_flat_ast(flat_ast, 0, flat_ast->count);
+        double flat_seconds = bench_time() - start;
+
+        if (pointer_visited != flat_visited) {
+            printf("node counts differ\n");
+            return 1;
+        }
+        if (pointer_best == 0 || pointer_seconds < pointer_best) pointer_best = pointer_seconds;
+        if (flat_best == 0 || flat_seconds < flat_best) flat_best = flat_seconds;
+    }
+    bench_report("walk pointer AST", size, pointer_best);
+    bench_report("walk flat AST", size, flat_best);
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../../src/lexer.h"
+#include "../../src/parser.h"
+#include "../../src/flat.h"
+#include "../../src/cache.h"
+
+#define INPUT_SIZE (16 * 1024 * 1024)
+#define ITERATIONS 5
+
+//lex, parse and flatten, then write the cache, like a compilation with an empty cache directory
+static double cold_run(Source *source, char *directory) {
+    double start = bench_time();
+    Token_List *tokens = new_token_list();
+    Arena *ast_arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+    if (tokenize(source, tokens)) {
+        printf("lexer failed\n");
+        exit(1);
+    }
+    AST_Node *root = parse(tokens, ast_arena);
+    if (root == NULL) {
+        printf("parser failed\n");
+        exit(1);
+    }
+    Flat_AST *ast = flatten_ast(root, tokens);
+    free_arena(ast_arena);
+    if (store_ast_cache(directory, source, tokens, ast)) {
+        printf("could not write cache\n");
+        exit(1);
+    }
+    double seconds = bench_time() - start;
+    free_flat_ast(ast);
+    free_token_list(tokens);
+    return seconds;
+}
+
+//map the cache and touch every node, so the pages are actually read
+static double warm_run(Source *source, char *directory) {
+    double start = bench_time();
+    Ast_Cache *cache = load_ast_cache(directory, source);
+    if (cache == NULL) {
+        printf("cache miss\n");
+        exit(1);
+    }
+    long sum = 0;
+    for (int i = 0; i < cache->ast->count; i++) {
+        sum += cache->ast->nodes[i].token;
+    }
+    double seconds = bench_time() - start;
+    if (sum < 0) printf("unexpected token sum\n");
+    free_ast_cache(cache);
+    return seconds;
+}
+
+int main() {
+    int size;
+    char *text = generate_program(INPUT_SIZE, &size);
+    Source *source = new_source(text, size);
+    char directory[] = "/tmp/bench_ast_cache_XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        printf("could not create cache directory\n");
+        return 1;
+    }
+
+    printf("==== AST cache: %d bytes ====\n", size);
+    double cold_best = 0, warm_best = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        double cold_seconds = cold_run(source, directory);
+        double warm_seconds = warm_run(source, directory);
+        if (cold_best == 0 || cold_seconds < cold_best) cold_best = cold_seconds;
+        if (warm_best == 0 || warm_seconds < warm_best) warm_best = warm_seconds;
+    }
+    bench_report("cold (lex, parse, flatten, store)", size, cold_best);
+    bench_report("warm (load cache)", size, warm_best);
+    printf("%-40s %10.1fx\n", "speedup", cold_best / warm_best);
+
+    char command[64];
+    sprintf(command, "rm -rf %s", directory);
+    system(command);
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../../src/lexer.h"
+#include "../../src/parser.h"
+#include "../../src/flat.h"
+#include "../../src/symbol.h"
+#include "../../src/analysis.h"
+#include "../../src/compiler.h"
+#include "../../src/codegen.h"
+
+#define INPUT_SIZE (16 * 1024 * 1024)
+#define ITERATIONS 5
+
+//best time of codegen for the analyzed program into out_file, the amount of emitted bytes is stored in emitted
+//without out_file only machine code is generated (as for an executable)
+double codegen_best(Token_List *tokens, Flat_AST *ast, FILE *out_file, long *emitted) {
+    double best = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        //codegen assigns addresses and mangle indices, so every run needs a freshly analyzed context
+        Compiler_Context *context = new_compiler_context();
+        context->tokens = tokens;
+        context->ast = ast;
+        context->symbol_arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+        context->table = new_symbol_table(tokens, context->symbol_arena);
+        if (semantic_analysis(ast, context->table)) {
+            return -1;
+        }
+
+        //codegen only checks whether an executable is requested, it is written by compile
+        if (out_file == NULL) {
+            context->executable_file = stdout;
+        }
+        else {
+            rewind(out_file);
+        }
+        double start = bench_time();
+        int err = codegen(context, out_file);
+        double seconds = bench_time() - start;
+        if (out_file == NULL) {
+            *emitted = err ? 0 : context->code->size;
+        }
+        else {
+            fflush(out_file);
+            *emitted = ftell(out_file);
+        }
+
+        //tokens and ast are shared between the runs
+        context->tokens = NULL;
+        context->ast = NULL;
+        free_compiler_context(context);
+        if (err) {
+            return -1;
+        }
+        if (best == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+//throughput of codegen in emitted bytes of assembly (or machine code) per second
+int main() {
+    int size;
+    char *text = generate_program(INPUT_SIZE, &size);
+    Token_List *tokens = new_token_list();
+    if (tokenize(new_source(text, size), tokens)) {
+        printf("lexer failed\n");
+        return 1;
+    }
+    Arena *arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+    Flat_AST *ast = flatten_ast(parse(tokens, arena), tokens);
+    free_arena(arena);
+
+    printf("==== CODEGEN: emitted assembly and machine code of a %d MB program ====\n", size / (1024 * 1024));
+    //a file is written with large write() calls, a memory stream gets the whole output at once
+    FILE *file = tmpfile();
+    char *memory = NULL;
+    size_t memory_size = 0;
+    FILE *memory_stream = open_memstream(&memory, &memory_size);
+    long file_bytes = 0, memory_bytes = 0, code_bytes = 0;
+    double file_seconds = codegen_best(tokens, ast, file, &file_bytes);
+    double memory_seconds = codegen_best(tokens, ast, memory_stream, &memory_bytes);
+    double code_seconds = codegen_best(tokens, ast, NULL, &code_bytes);
+    if (file_seconds < 0 || memory_seconds < 0 || code_seconds < 0) {
+        printf("codegen failed\n");
+        return 1;
+    }
+    bench_report("codegen (file)", file_bytes, file_seconds);
+    bench_report("codegen (memory stream)", memory_bytes, memory_seconds);
+    bench_report("codegen (machine code)", code_bytes, code_seconds);
+
+    fclose(file);
+    fclose(memory_stream);
+    free(memory);
+    free_flat_ast(ast);
+    free_token_list(tokens);
+    free(text);
+    return 0;
+}
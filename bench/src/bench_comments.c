@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../../src/lexer.h"
+#include "../../src/scan.h"
+
+#define INPUT_SIZE (64 * 1024 * 1024)
+#define ITERATIONS 5
+
+char *kernel_names[] = { "scalar", "sse2", "avx2" };
+
+//best time of several runs of tokenize() with the given scan kernels
+double measure(Source *source, Scan_Kernels kernels) {
+    scan_select(kernels);
+    double best = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        Token_List *tokens = new_token_list();
+        double start = bench_time();
+        int err = tokenize(source, tokens);
+        double seconds = bench_time() - start;
+        if (err) {
+            printf("lexer failed\n");
+            exit(1);
+        }
+        if (best == 0 || seconds < best) {
+            best = seconds;
+        }
+        free_token_list(tokens);
+    }
+    return best;
+}
+
+int main() {
+    int size;
+    char *text = generate_commented_program(INPUT_SIZE, &size);
+    Source *source = new_source(text, size);
+
+    printf("==== COMMENT HEAVY LEXING: %d bytes ====\n", size);
+    double scalar = measure(source, SCAN_SCALAR);
+    bench_report("tokenize (scalar)", size, scalar);
+    for (Scan_Kernels kernels = SCAN_SSE2; kernels <= scan_detect(); kernels++) {
+        char name[64];
+        double seconds = measure(source, kernels);
+        sprintf(name, "tokenize (%s)", kernel_names[kernels]);
+        bench_report(name, size, seconds);
+        printf("speedup over scalar: %.2fx\n", scalar / seconds);
+    }
+    return 0;
+}
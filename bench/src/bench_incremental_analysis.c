@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "../../src/lexer.h"
+#include "../../src/parser.h"
+#include "../../src/flat.h"
+#include "../../src/symbol.h"
+#include "../../src/analysis.h"
+#include "../../src/cache.h"
+
+#define INPUT_SIZE (16 * 1024 * 1024)
+#define ITERATIONS 3
+#define NESTED_DEPTH 12
+#define NESTED_COUNT 40000
+
+typedef struct {
+    Token_List *tokens;
+    Flat_AST *ast;
+} Program;
+
+Program front_end(char *text, int size) {
+    Program program;
+    program.tokens = new_token_list();
+    tokenize(new_source(text, size), program.tokens);
+    Arena *arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+    program.ast = flatten_ast(parse(program.tokens, arena), program.tokens);
+    free_arena(arena);
+    return program;
+}
+
+//best time of a full analysis
+double analyze_best(Program *program) {
+    double best = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        Arena *arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+        Symbol_Table *table = new_symbol_table(program->tokens, arena);
+        double start = bench_time();
+        int err = semantic_analysis(program->ast, table);
+        double seconds = bench_time() - start;
+        free_arena(arena);
+        if (err) {
+            return -1;
+        }
+        if (best == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+//best time of an incremental analysis with the cache of directory (loading the cache included, storing it excluded)
+//the cache of the last run is stored, so every run starts from the same cache if store is 0
+double analyze_incremental_best(Program *program, char *directory, int store, int *reused, int *analyzed) {
+    double best = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        Arena *arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+        Symbol_Table *table = new_symbol_table(program->tokens, arena);
+        double start = bench_time();
+        Analysis_Cache *cache = load_analysis_cache(directory);
+        int err = semantic_analysis_incremental(program->ast, table, cache, reused, analyzed);
+        double seconds = bench_time() - start;
+        if (!err && store && i == ITERATIONS - 1) {
+            err = store_analysis_cache(directory, cache);
+        }
+        free_analysis_cache(cache);
+        free_arena(arena);
+        if (err) {
+            return -1;
+        }
+        if (best == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+//analyze the program and the changed program, fully and incrementally
+int run(char *title, Program *program, Program *changed, int size, char *directory) {
+    int function_count = 0;
+    for (int statement = 1; statement < program->ast->count; statement = flat_end(program->ast, statement)) {
+        function_count += flat_kind(program->ast, statement) == ND_FUNCTION_DEF;
+    }
+    double full_seconds = analyze_best(program);
+    if (full_seconds < 0) {
+        printf("semantic analysis failed\n");
+        return 1;
+    }
+    printf("==== INCREMENTAL SEMANTIC ANALYSIS (%s): %d bytes, %d nodes, %d top-level functions ====\n", title, size, program->ast->count, function_count);
+    bench_report("semantic_analysis (full)", size, full_seconds);
+
+    int reused, analyzed;
+    char *names[] = { "incremental (empty cache)", "incremental (unchanged)", "incremental (one changed function)" };
+    Program *programs[] = { program, program, changed };
+    for (int i = 0; i < 3; i++) {
+        //only the first run fills the cache, the others reuse it
+        double seconds = analyze_incremental_best(programs[i], directory, i == 0, &reused, &analyzed);
+        if (seconds < 0) {
+            printf("incremental analysis failed\n");
+            return 1;
+        }
+        bench_report(names[i], size, seconds);
+        printf("%d functions reused, %d functions analyzed, speedup over full analysis: %.2fx\n", reused, analyzed, full_seconds / seconds);
+    }
+    return 0;
+}
+
+//copy of text with the first occurence of pattern after the middle changed to replacement (of the same length)
+char *change_function(char *text, int size, char *pattern, char *replacement) {
+    char *changed = malloc(size);
+    memcpy(changed, text, size);
+    char *match = strstr(changed + size / 2, pattern);
+    memcpy(match, replacement, strlen(replacement));
+    return changed;
+}
+
+int main() {
+    char directory[] = "/tmp/bench_analysis_cache_XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        printf("could not create cache directory\n");
+        return 1;
+    }
+    //small function bodies, most of the work is at the top level
+    int size;
+    char *text = generate_program(INPUT_SIZE, &size);
+    char *changed_text = change_function(text, size, "+ 2\n}", "+ 3");
+    Program program = front_end(text, size);
+    Program changed = front_end(changed_text, size);
+    int err = run("small bodies", &program, &changed, size, directory);
+    if (err) return err;
+
+    //large function bodies made of nested functions and conditions
+    text = generate_nested_program(NESTED_DEPTH, NESTED_COUNT, &size);
+    changed_text = change_function(text, size, "value + 1", "value - 1");
+    program = front_end(text, size);
+    changed = front_end(changed_text, size);
+    err = run("large bodies", &program, &changed, size, directory);
+    if (err) return err;
+
+    char command[64];
+    sprintf(command, "rm -rf %s", directory);
+    system(command);
+    return 0;
+}
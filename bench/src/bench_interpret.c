@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "bench.h"
+#include "../../src/compiler.h"
+
+#define ITERATIONS 5
+#define PATH_SIZE 256
+#define PROGRAM_SIZE 512
+
+//run the executable at path and wait for it, return its exit status
+int execute(char *path) {
+    pid_t child = fork();
+    if (child == 0) {
+        execl(path, path, NULL);
+        _exit(127);
+    }
+    int status;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+//best time of compiling and interpreting text, -1 if it failed
+double interpret_best(char *text) {
+    double best = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        Compiler_Context *context = new_compiler_context();
+        context->interpret = 1;
+        double start = bench_time();
+        int err = compile(context, new_source(text, strlen(text)), NULL);
+        double seconds = bench_time() - start;
+        free_compiler_context(context);
+        if (err) return -1;
+        if (best == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+//best time of compiling text to an executable and running it, -1 if it failed
+double native_best(char *text, char *path) {
+    double best = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        Compiler_Context *context = new_compiler_context();
+        double start = bench_time();
+        context->executable_file = fopen(path, "w");
+        if (context->executable_file == NULL) {
+            printf("could not open %s\n", path);
+            free_compiler_context(context);
+            return -1;
+        }
+        int err = compile(context, new_source(text, strlen(text)), NULL);
+        fclose(context->executable_file);
+        chmod(path, 0700);
+        err = err || execute(path);
+        double seconds = bench_time() - start;
+        free_compiler_context(context);
+        if (err) return -1;
+        if (best == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+//time to result of the bytecode interpreter compared to the native executable out/out
+//on recursion loops (a counter that is decremented until it reaches 0)
+int main() {
+    char directory[] = "/tmp/bench_interpret_XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        printf("could not create a temporary directory\n");
+        return 1;
+    }
+    char path[PATH_SIZE];
+    snprintf(path, PATH_SIZE, "%s/out", directory);
+
+    printf("==== INTERPRET: bytecode interpreter compared to the native executable on recursion loops ====\n");
+    printf("%12s %14s %14s %16s %16s\n", "iterations", "interpret", "native", "interpret it/s", "native it/s");
+    long counts[] = { 10, 1000, 100000, 10000000, 100000000 };
+    for (int i = 0; i < (int) (sizeof(counts) / sizeof(long)); i++) {
+        char text[PROGRAM_SIZE];
+        snprintf(text, PROGRAM_SIZE,
+            "counter = %ld\n"
+            "total = 0\n"
+            "function loop {\n"
+            "    if (counter != 0) {\n"
+            "        counter = counter - 1\n"
+            "        total = total + 3\n"
+            "        loop()\n"
+            "    }\n"
+            "}\n"
+            "loop()\n", counts[i]);
+        double interpret = interpret_best(text);
+        double native = native_best(text, path);
+        if (interpret < 0 || native < 0) {
+            printf("loop of %ld iterations failed\n", counts[i]);
+            return 1;
+        }
+        printf("%12ld %11.3f ms %11.3f ms %16.3e %16.3e\n", counts[i], interpret * 1e3, native * 1e3, counts[i] / interpret, counts[i] / native);
+    }
+    return 0;
+}
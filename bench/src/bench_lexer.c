@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../../src/lexer.h"
+
+#define INPUT_SIZE (64 * 1024 * 1024)
+#define ITERATIONS 5
+//lexer throughput target on plain ASCII programs in bytes per second
+#define TARGET_THROUGHPUT 1e9
+
+int main() {
+    int size;
+    char *text = generate_program(INPUT_SIZE, &size);
+    Source *source = new_source(text, size);
+
+    //best of several runs, the first run also pays for page faults of the token list
+    double best = 0;
+    int token_count = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        Token_List *tokens = new_token_list();
+        double start = bench_time();
+        int err = tokenize(source, tokens);
+        double seconds = bench_time() - start;
+        if (err) {
+            printf("lexer failed\n");
+            return 1;
+        }
+        if (best == 0 || seconds < best) {
+            best = seconds;
+        }
+        token_count = tokens->count;
+        free_token_list(tokens);
+    }
+
+    printf("==== LEXER: %d bytes, %d tokens ====\n", size, token_count);
+    bench_report("tokenize (plain ASCII)", size, best);
+    printf("target %.1f GB/s: %s\n", TARGET_THROUGHPUT / 1e9, size / best >= TARGET_THROUGHPUT ? "met" : "missed");
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "../../src/lexer.h"
+#include "../../src/parser.h"
+#include "../../src/flat.h"
+#include "../../src/symbol.h"
+#include "../../src/analysis.h"
+#include "../../src/pool.h"
+
+#define INPUT_SIZE (16 * 1024 * 1024)
+#define ITERATIONS 3
+#define MAX_THREADS 32
+
+//analyze with semantic_analysis_parallel (or semantic_analysis if pool is NULL), return the best time or -1 on error
+//the scope count of the last run is stored in scope_count to compare the results
+double analyze_best(Flat_AST *ast, Token_List *tokens, Thread_Pool *pool, int *scope_count) {
+    double best = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        Arena *arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+        Symbol_Table *table = new_symbol_table(tokens, arena);
+        double start = bench_time();
+        int err = pool == NULL ? semantic_analysis(ast, table) : semantic_analysis_parallel(ast, table, pool);
+        double seconds = bench_time() - start;
+        *scope_count = table->scope_count;
+        free_arena(arena);
+        if (err) {
+            return -1;
+        }
+        if (best == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+int main() {
+    int size;
+    char *text = generate_program(INPUT_SIZE, &size);
+    Token_List *tokens = new_token_list();
+    if (tokenize(new_source(text, size), tokens)) {
+        printf("lexer failed\n");
+        return 1;
+    }
+    Arena *ast_arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+    AST_Node *root = parse(tokens, ast_arena);
+    if (root == NULL) {
+        printf("parser failed\n");
+        return 1;
+    }
+    Flat_AST *ast = flatten_ast(root, tokens);
+    free_arena(ast_arena);
+    int function_count = 0;
+    for (int statement = 1; statement < ast->count; statement = flat_end(ast, statement)) {
+        function_count += flat_kind(ast, statement) == ND_FUNCTION_DEF;
+    }
+
+    int serial_scopes;
+    double serial_seconds = analyze_best(ast, tokens, NULL, &serial_scopes);
+    if (serial_seconds < 0) {
+        printf("semantic analysis failed\n");
+        return 1;
+    }
+
+    printf("==== PARALLEL SEMANTIC ANALYSIS: %d bytes, %d nodes, %d top-level functions ====\n", size, ast->count, function_count);
+    bench_report("semantic_analysis (serial)", size, serial_seconds);
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        Thread_Pool *pool = new_thread_pool(threads);
+        int scopes;
+        double best = analyze_best(ast, tokens, pool, &scopes);
+        free_thread_pool(pool);
+        if (best < 0 || scopes != serial_scopes) {
+            printf("parallel result differs from serial result (%d threads)\n", threads);
+            return 1;
+        }
+        char name[64];
+        sprintf(name, "semantic_analysis_parallel (%d threads)", threads);
+        bench_report(name, size, best);
+        printf("speedup over serial: %.2fx\n", serial_seconds / best);
+    }
+    return 0;
+}
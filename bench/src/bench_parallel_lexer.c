@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "../../src/lexer.h"
+#include "../../src/pool.h"
+
+#define INPUT_SIZE (256 * 1024 * 1024)
+#define ITERATIONS 3
+#define MAX_THREADS 32
+
+int same_tokens(Token_List *first, Token_List *second) {
+    return first->count == second->count
+        && memcmp(first->types, second->types, first->count * sizeof(Token_Type)) == 0
+        && memcmp(first->offsets, second->offsets, first->count * sizeof(long)) == 0
+        && memcmp(first->lengths, second->lengths, first->count * sizeof(int)) == 0;
+}
+
+int main() {
+    int size;
+    //comment heavy, so chunk boundaries regularly fall into block comments
+    char *text = generate_commented_program(INPUT_SIZE, &size);
+    Source *source = new_source(text, size);
+
+    Token_List *serial = NULL;
+    double serial_seconds = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        if (serial != NULL) {
+            free_token_list(serial);
+        }
+        serial = new_token_list();
+        double start = bench_time();
+        tokenize(source, serial);
+        double seconds = bench_time() - start;
+        if (serial_seconds == 0 || seconds < serial_seconds) {
+            serial_seconds = seconds;
+        }
+    }
+
+    printf("==== PARALLEL LEXING: %d bytes ====\n", size);
+    bench_report("tokenize (serial)", size, serial_seconds);
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        Thread_Pool *pool = new_thread_pool(threads);
+        double best = 0;
+        for (int i = 0; i < ITERATIONS; i++) {
+            Token_List *tokens = new_token_list();
+            double start = bench_time();
+            int err = tokenize_parallel(source, tokens, pool);
+            double seconds = bench_time() - start;
+            if (err || !same_tokens(serial, tokens)) {
+                printf("parallel result differs from serial result (%d threads)\n", threads);
+                return 1;
+            }
+            if (best == 0 || seconds < best) {
+                best = seconds;
+            }
+            free_token_list(tokens);
+        }
+        free_thread_pool(pool);
+        char name[64];
+        sprintf(name, "tokenize_parallel (%d threads)", threads);
+        bench_report(name, size, best);
+        printf("speedup over serial: %.2fx\n", serial_seconds / best);
+    }
+    return 0;
+}
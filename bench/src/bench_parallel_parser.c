@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "../../src/lexer.h"
+#include "../../src/parser.h"
+#include "../../src/flat.h"
+#include "../../src/pool.h"
+
+#define INPUT_SIZE (64 * 1024 * 1024)
+#define ITERATIONS 3
+#define MAX_THREADS 32
+
+//parse with parse_parallel (or parse if pool is NULL), store the best time in best and return the flattened AST of the last run
+Flat_AST *parse_best(Token_List *tokens, Thread_Pool *pool, double *best) {
+    Flat_AST *flat_ast = NULL;
+    *best = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        Arena *arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+        tokens->current = 0;
+        double start = bench_time();
+        AST_Node *ast = pool == NULL ? parse(tokens, arena) : parse_parallel(tokens, arena, pool);
+        double seconds = bench_time() - start;
+        if (ast == NULL) {
+            return NULL;
+        }
+        if (*best == 0 || seconds < *best) {
+            *best = seconds;
+        }
+        if (flat_ast != NULL) {
+            free_flat_ast(flat_ast);
+        }
+        flat_ast = flatten_ast(ast, tokens);
+        free_arena(arena);
+    }
+    return flat_ast;
+}
+
+int main() {
+    int size;
+    char *text = generate_program(INPUT_SIZE, &size);
+    Token_List *tokens = new_token_list();
+    if (tokenize(new_source(text, size), tokens)) {
+        printf("lexer failed\n");
+        return 1;
+    }
+
+    double serial_seconds;
+    Flat_AST *serial = parse_best(tokens, NULL, &serial_seconds);
+    if (serial == NULL) {
+        printf("parser failed\n");
+        return 1;
+    }
+
+    printf("==== PARALLEL PARSING: %d bytes, %d tokens ====\n", size, tokens->count);
+    bench_report("parse (serial)", size, serial_seconds);
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        Thread_Pool *pool = new_thread_pool(threads);
+        double best;
+        Flat_AST *parallel = parse_best(tokens, pool, &best);
+        free_thread_pool(pool);
+        if (parallel == NULL || parallel->count != serial->count || memcmp(parallel->nodes, serial->nodes, serial->count * sizeof(Flat_Node)) != 0) {
+            printf("parallel result differs from serial result (%d threads)\n", threads);
+            return 1;
+        }
+        free_flat_ast(parallel);
+        char name[64];
+        sprintf(name, "parse_parallel (%d threads)", threads);
+        bench_report(name, size, best);
+        printf("speedup over serial: %.2fx\n", serial_seconds / best);
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../../src/lexer.h"
+#include "../../src/parser.h"
+
+//total amount of nesting levels of each input, split into blocks of different depths
+#define TOTAL_LEVELS (1 << 18)
+#define ITERATIONS 5
+
+//parse time per token has to stay flat with increasing depth, otherwise the parser is not linear
+int main() {
+    printf("==== PARSER: deeply nested functions and conditions ====\n");
+    for (int depth = 2; depth <= 32 * 1024; depth *= 8) {
+        int size;
+        char *text = generate_nested_program(depth, TOTAL_LEVELS / depth, &size);
+        Source *source = new_source(text, size);
+        Token_List *tokens = new_token_list();
+        if (tokenize(source, tokens)) {
+            printf("lexer failed\n");
+            return 1;
+        }
+
+        double best = 0;
+        for (int i = 0; i < ITERATIONS; i++) {
+            Arena *arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+            tokens->current = 0;
+            double start = bench_time();
+            AST_Node *ast = parse(tokens, arena);
+            double seconds = bench_time() - start;
+            if (ast == NULL || token_list_current(tokens) != NO_TOKEN) {
+                printf("parser failed\n");
+                return 1;
+            }
+            if (best == 0 || seconds < best) {
+                best = seconds;
+            }
+            free_arena(arena);
+        }
+
+        char name[64];
+        sprintf(name, "parse (depth %d)", depth);
+        bench_report(name, size, best);
+        printf("%-40s %10.1f ns/token\n", "", best * 1e9 / tokens->count);
+        free_token_list(tokens);
+        free(text);
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "bench.h"
+#include "../../src/compiler.h"
+
+#define ITERATIONS 200
+//the nasm and ld path is much slower, fewer runs are enough
+#define TOOL_ITERATIONS 20
+#define PATH_SIZE 256
+#define STATEMENT_COUNT 500
+
+typedef struct {
+    char *name;
+    char *text;
+} Program;
+
+//run the executable at path and wait for it, return its exit status
+int execute(char *path) {
+    pid_t child = fork();
+    if (child == 0) {
+        execl(path, path, NULL);
+        _exit(127);
+    }
+    int status;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+//compile program with the given outputs (NULL to skip), return the result of compile
+int compile_to(Program *program, char *asm_path, char *executable_path, int run) {
+    FILE *asm_file = NULL;
+    if (asm_path != NULL) {
+        asm_file = fopen(asm_path, "w");
+        if (asm_file == NULL) {
+            printf("could not open %s\n", asm_path);
+            return 1;
+        }
+    }
+    Compiler_Context *context = new_compiler_context();
+    context->run = run;
+    if (executable_path != NULL) {
+        context->executable_file = fopen(executable_path, "w");
+        if (context->executable_file == NULL) {
+            printf("could not open %s\n", executable_path);
+            if (asm_file != NULL) fclose(asm_file);
+            free_compiler_context(context);
+            return 1;
+        }
+    }
+    int err = compile(context, new_source(program->text, strlen(program->text)), asm_file);
+    if (asm_file != NULL) fclose(asm_file);
+    if (context->executable_file != NULL) {
+        fclose(context->executable_file);
+        chmod(executable_path, 0700);
+    }
+    free_compiler_context(context);
+    return err;
+}
+
+//mean time of compile and run in microseconds, -1 if any run failed
+double jit_latency(Program *program) {
+    double start = bench_time();
+    for (int i = 0; i < ITERATIONS; i++) {
+        if (compile_to(program, NULL, NULL, 1)) return -1;
+    }
+    return (bench_time() - start) / ITERATIONS * 1e6;
+}
+
+double executable_latency(Program *program, char *directory) {
+    char path[PATH_SIZE];
+    snprintf(path, PATH_SIZE, "%s/out", directory);
+    double start = bench_time();
+    for (int i = 0; i < ITERATIONS; i++) {
+        if (compile_to(program, NULL, path, 0) || execute(path)) return -1;
+    }
+    return (bench_time() - start) / ITERATIONS * 1e6;
+}
+
+//the path before the built-in encoder: write the assembly, run nasm and ld, run the executable
+double tool_latency(Program *program, char *directory) {
+    char asm_path[PATH_SIZE], path[PATH_SIZE], command[4 * PATH_SIZE];
+    snprintf(asm_path, PATH_SIZE, "%s/out.asm", directory);
+    snprintf(path, PATH_SIZE, "%s/reference", directory);
+    snprintf(command, sizeof(command), "nasm -o %s/out.o -f elf64 %s", directory, asm_path);
+    char link_command[4 * PATH_SIZE];
+    snprintf(link_command, sizeof(link_command), "ld -o %s %s/out.o", path, directory);
+    double start = bench_time();
+    for (int i = 0; i < TOOL_ITERATIONS; i++) {
+        if (compile_to(program, asm_path, NULL, 0) || system(command) || system(link_command) || execute(path)) return -1;
+    }
+    return (bench_time() - start) / TOOL_ITERATIONS * 1e6;
+}
+
+//end-to-end latency of compiling and running small programs
+int main() {
+    //straight-line program of many assignments
+    char *statements = malloc(STATEMENT_COUNT * 32);
+    int pos = sprintf(statements, "v0 = 1\n");
+    for (int i = 1; i < STATEMENT_COUNT; i++) {
+        pos += sprintf(statements + pos, "v%d = v%d + %d\n", i, i - 1, i);
+    }
+    Program programs[] = {
+        {
+            "readme example",
+            "x1 = 1 + 2\nfunction abc {\n    if (x1 == 3) {\n        x1 = x1 + 1\n    } else {\n        x1 = x1 + 2\n    }\n"
+            "    x2 = x1 + 1\n    x3 = x1 + x2\n}\nabc()\n",
+        },
+        {
+            "loop of 100000 iterations",
+            "counter = 100000\nfunction loop {\n    if (counter != 0) {\n        counter = counter - 1\n        loop()\n    }\n}\nloop()\n",
+        },
+        { "500 assignments", statements },
+    };
+
+    char directory[] = "/tmp/bench_run_XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        printf("could not create a temporary directory\n");
+        return 1;
+    }
+    int has_tools = system("command -v nasm > /dev/null && command -v ld > /dev/null") == 0;
+
+    printf("==== RUN: compile and run latency of small programs ====\n");
+    for (int i = 0; i < (int) (sizeof(programs) / sizeof(Program)); i++) {
+        double jit = jit_latency(&programs[i]);
+        double executable = executable_latency(&programs[i], directory);
+        if (jit < 0 || executable < 0) {
+            printf("%s failed\n", programs[i].name);
+            return 1;
+        }
+        printf("%s\n", programs[i].name);
+        printf("    %-36s %10.1f us\n", "in process (--run)", jit);
+        printf("    %-36s %10.1f us\n", "executable + exec", executable);
+        if (has_tools) {
+            printf("    %-36s %10.1f us\n", "assembly + nasm + ld + exec", tool_latency(&programs[i], directory));
+        }
+        else {
+            printf("    %-36s %10s\n", "assembly + nasm + ld + exec", "skipped (nasm or ld not found)");
+        }
+    }
+    free(statements);
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../../src/lexer.h"
+#include "../../src/symbol.h"
+
+#define MAX_SYMBOLS (64 * 1024)
+#define LOOKUPS (1 << 22)
+//the linear scan is far slower on large scopes, so it gets fewer lookups
+#define LINEAR_LOOKUPS (1 << 16)
+
+//lookup like symbol_table_get did before scopes had a hash map
+static Symbol *linear_get(Scope *scope, int id) {
+    Collection_Container *container = scope->symbols->root;
+    while (container != NULL) {
+        Symbol *symbol = container->item;
+        if (symbol->id == id) {
+            return symbol;
+        }
+        container = container->next;
+    }
+    return NULL;
+}
+
+//lookup time per symbol has to stay flat with increasing scope size
+int main() {
+    //"v0 v1 v2 ...", token i is an identifier with the name vi
+    char *text = malloc(MAX_SYMBOLS * 8);
+    int size = 0;
+    for (int i = 0; i < MAX_SYMBOLS; i++) {
+        size += sprintf(text + size, "v%d ", i);
+    }
+    Token_List *tokens = new_token_list();
+    if (tokenize(new_source(text, size), tokens)) {
+        printf("lexer failed\n");
+        return 1;
+    }
+
+    printf("==== SYMBOL TABLE: lookups in a scope of n symbols ====\n");
+    for (int count = 16; count <= MAX_SYMBOLS; count *= 4) {
+        Arena *arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+        Symbol_Table *table = new_symbol_table(tokens, arena);
+        for (int i = 0; i < count; i++) {
+            symbol_table_set(table, new_symbol(arena, SYM_INT, i));
+        }
+        //lookups start in an empty child scope, like references inside of a function body
+        symbol_table_push(table);
+
+        //pseudo random order, so the lookups do not just walk the slots
+        unsigned int seed = 1;
+        long found = 0;
+        double start = bench_time();
+        for (int i = 0; i < LOOKUPS; i++) {
+            seed = seed * 1103515245 + 12345;
+            found += symbol_table_get(table, (seed >> 8) % count) != NULL;
+        }
+        double hash_seconds = bench_time() - start;
+
+        start = bench_time();
+        for (int i = 0; i < LINEAR_LOOKUPS; i++) {
+            seed = seed * 1103515245 + 12345;
+            found += linear_get(symbol_table_scope(table, ROOT_SCOPE), token_id(tokens, (seed >> 8) % count)) != NULL;
+        }
+        double linear_seconds = bench_time() - start;
+
+        if (found != LOOKUPS + LINEAR_LOOKUPS) {
+            printf("symbols missing\n");
+            return 1;
+        }
+        printf("n = %-36d %10.1f ns/lookup (hash map)\n", count, hash_seconds * 1e9 / LOOKUPS);
+        printf("%-40s %10.1f ns/lookup (linear list)\n", "", linear_seconds * 1e9 / LINEAR_LOOKUPS);
+        free_arena(arena);
+    }
+    free_token_list(tokens);
+    free(text);
+    return 0;
+}
@@ -1,112 +1,639 @@
 #include <stdlib.h>
 #include <stdio.h>
-#include "parser.h"
+#include <string.h>
+#include "flat.h"
 #include "symbol.h"
+#include "analysis.h"
 
-int check_symbols(AST_Node *statement, Symbol_Table *table) {
+//report an error about the symbol referred to by token at the position of the token
+#define symbol_error(table, token, fmt) \
+    source_error((table)->tokens->source, (table)->tokens->offsets[token], fmt, token_fmt((table)->tokens, token))
+
+//check and register the name of a function definition
+static int declare_function(Flat_AST *ast, int statement, Symbol_Table *table) {
+    int name = ast->nodes[statement].token;
+    if (symbol_table_get(table, name)) {
+        return symbol_error(table, name, "redefinition of %.*s");
+    }
+    Symbol *sym = new_symbol(table->arena, SYM_FUNC, name);
+    symbol_table_set(table, sym);
+    symbol_table_resolve(table, statement, sym);
+    return 0;
+}
+
+//check the nodes in [statement, end), end is the end of the parent subtree (or statement + 1 for a single node)
+int check_symbols(Flat_AST *ast, int statement, int end, Symbol_Table *table) {
     int err = 0;
-    while (statement != NULL) {
-        if (statement->node_type == ND_FUNCTION_DEF) {
-            //check and register function name
-            if (symbol_table_get(table, statement->token)) {
-                printf("ERROR: redefinition of %s\n", statement->token->value);
-                return 1;
-            }
-            symbol_table_set(table, new_symbol(SYM_FUNC, statement->token));
+    while (statement < end) {
+        Flat_Node *node = &ast->nodes[statement];
+        symbol_table_resolve(table, statement, NULL);
+        if (node->kind == ND_FUNCTION_DEF) {
+            err = declare_function(ast, statement, table);
+            if (err) return err;
             //check function contents
             symbol_table_push(table);
-            err = check_symbols(statement->children, table);
+            err = check_symbols(ast, statement + 1, flat_end(ast, statement), table);
             if (err) return err;
             symbol_table_pop(table);
         }
-        else if (statement->node_type == ND_FUNCTION_CALL) {
-            Symbol *sym = symbol_table_get(table, statement->token);
+        else if (node->kind == ND_FUNCTION_CALL) {
+            Symbol *sym = symbol_table_get(table, node->token);
             //check if function is defined
             if (!sym) {
-                printf("ERROR: %s is not defined\n", statement->token->value);
-                return 1;
+                return symbol_error(table, node->token, "%.*s is not defined");
             }
             //check if function even is a function
             if (sym->type != SYM_FUNC) {
-                printf("ERROR: %s is not callable\n", statement->token->value);
-                return 1;
+                return symbol_error(table, node->token, "%.*s is not callable");
             }
+            symbol_table_resolve(table, statement, sym);
         }
-        else if (statement->node_type == ND_BOOLEAN) {
-            err = check_symbols(statement->lhs, table);
-            if (err) return err;
-            err = check_symbols(statement->rhs, table);
+        else if (node->kind == ND_BOOLEAN) {
+            //check both summands
+            err = check_symbols(ast, statement + 1, flat_end(ast, statement), table);
             if (err) return err;
         }
-        else if (statement->node_type == ND_COND) {
+        else if (node->kind == ND_COND) {
             //check condition bool
-            err = check_symbols(statement->ms, table);
+            int bool = flat_cond_bool(ast, statement);
+            err = check_symbols(ast, bool, bool + 1, table);
             if (err) return err;
             //check 'true case' contents
+            int cond_true = flat_cond_true(ast, statement);
             symbol_table_push(table);
-            err = check_symbols(statement->lhs->children, table);
+            symbol_table_resolve(table, cond_true, NULL);
+            err = check_symbols(ast, cond_true + 1, flat_end(ast, cond_true), table);
             if (err) return err;
             symbol_table_pop(table);
             //check 'false case' contents
-            if (statement->rhs != NULL) {
+            int cond_false = flat_cond_false(ast, statement);
+            if (cond_false != NO_NODE) {
                 symbol_table_push(table);
-                err = check_symbols(statement->rhs->children, table);
+                symbol_table_resolve(table, cond_false, NULL);
+                err = check_symbols(ast, cond_false + 1, flat_end(ast, cond_false), table);
                 if (err) return err;
                 symbol_table_pop(table);
             }
         }
-        else if (statement->node_type == ND_ASSIGN) {
+        else if (node->kind == ND_ASSIGN) {
             //rhs of assign needs to be check first
             //this way, a variable can't be assigned to itself during its initial assignment
-            err = check_symbols(statement->rhs, table);
+            int lhs = flat_lhs(ast, statement);
+            int rhs = flat_rhs(ast, statement);
+            err = check_symbols(ast, rhs, rhs + 1, table);
             if (err) return err;
 
             //register assigned symbol if it does not exist yet
-            if (!symbol_table_get(table, statement->lhs->token)) {
-                symbol_table_set(table, new_symbol(SYM_INT, statement->lhs->token));
+            if (!symbol_table_get(table, ast->nodes[lhs].token)) {
+                Symbol *sym = new_symbol(table->arena, SYM_INT, ast->nodes[lhs].token);
+                symbol_table_set(table, sym);
+                symbol_table_resolve(table, lhs, sym);
             }
             else {
                 //if symbol already exists, check it (e.g. for type)
-                err = check_symbols(statement->lhs, table);
+                err = check_symbols(ast, lhs, lhs + 1, table);
                 if (err) return err;
             }
+            //the assignment refers to the same symbol as its variable
+            symbol_table_resolve(table, statement, resolved_symbol(table, lhs));
         }
-        else if (statement->node_type == ND_ADD || statement->node_type == ND_SUB) {
+        else if (node->kind == ND_ADD || node->kind == ND_SUB) {
             //check both parts of addition or subtraction
-            err = check_symbols(statement->lhs, table);
-            if (err) return err;
-            err = check_symbols(statement->rhs, table);
+            err = check_symbols(ast, statement + 1, flat_end(ast, statement), table);
             if (err) return err;
         }
-        else if (statement->node_type == ND_VAR) {
-            Symbol *sym = symbol_table_get(table, statement->token);
+        else if (node->kind == ND_VAR) {
+            Symbol *sym = symbol_table_get(table, node->token);
             if (!sym) {
-                printf("ERROR: %s is not defined\n", statement->token->value);
-                return 1;
+                return symbol_error(table, node->token, "%.*s is not defined");
             }
             //check type
             if (sym->type != SYM_INT) {
-                printf("ERROR: %s has mismatched type\n", statement->token->value);
-                return 1;
+                return symbol_error(table, node->token, "%.*s has mismatched type");
             }
+            symbol_table_resolve(table, statement, sym);
         }
         //throw error except for nodes that do not have to be checked
-        else if (statement->node_type != ND_INT) {
+        else if (node->kind != ND_INT) {
             printf("INTERNAL ERROR: cannot process AST-Node Type\n");
             return 1;
         }
         //forward
-        statement = statement->next;
+        statement = flat_end(ast, statement);
     }
 
     return 0;
 }
 
-int semantic_analysis(AST_Node *ast_root, Symbol_Table *table) {
-    if (ast_root->node_type != ND_ROOT) {
+int semantic_analysis(Flat_AST *ast, Symbol_Table *table) {
+    if (ast->count == 0 || flat_kind(ast, 0) != ND_ROOT) {
         printf("INTERNAL ERROR: AST has no root node\n");
         return 1;
     }
 
-    return check_symbols(ast_root->children, table);
+    //every name is resolved exactly once here, later steps only read the resolutions
+    symbol_table_init_resolved(table, ast->count);
+    symbol_table_resolve(table, 0, NULL);
+    return check_symbols(ast, 1, ast->count, table);
+}
+
+//parallel analysis
+
+//minimum amount of nodes in the function bodies of a batch, smaller inputs are analyzed serially
+#define PARALLEL_MIN_BATCH_NODES (16 * 1024)
+//more batches than threads, so idle workers can steal the remaining ones if the batches are uneven
+#define BATCHES_PER_THREAD 4
+
+typedef struct {
+    Flat_AST *ast;
+    //view of the shared table with the silent tokens and its own arena
+    Symbol_Table *table;
+    //[first, end) of the top-level function definitions (and the ids of their body scopes)
+    int *functions, *scopes;
+    int first, end;
+    int err;
+} Analysis_Batch;
+
+//amount of scopes analysis creates for the subtree of node (one per function definition and case of a condition)
+static int count_scopes(Flat_AST *ast, int node) {
+    int count = 0;
+    for (int i = node; i < flat_end(ast, node); i++) {
+        AST_Node_Type kind = flat_kind(ast, i);
+        count += kind == ND_FUNCTION_DEF || kind == ND_COND_TRUE || kind == ND_COND_FALSE;
+    }
+    return count;
+}
+
+//first phase: check all top-level statements in order, but only declare top-level functions
+//the scopes of every body are reserved, so they get the same ids as in a serial analysis
+//return the amount of function bodies stored in functions (and their body scopes in scopes), -1 on error
+static int declare_top_level(Flat_AST *ast, Symbol_Table *table, int *functions, int *scopes) {
+    int function_count = 0;
+    int statement = 1;
+    while (statement < ast->count) {
+        if (flat_kind(ast, statement) == ND_FUNCTION_DEF) {
+            if (declare_function(ast, statement, table)) return -1;
+            symbol_table_push(table);
+            functions[function_count] = statement;
+            scopes[function_count] = table->current;
+            function_count += 1;
+            symbol_table_skip_scopes(table, count_scopes(ast, statement) - 1);
+            symbol_table_pop(table);
+        }
+        else if (check_symbols(ast, statement, flat_end(ast, statement), table)) {
+            return -1;
+        }
+        statement = flat_end(ast, statement);
+    }
+    return function_count;
+}
+
+//second phase: check the bodies of the batch, they only read the root scope and write their own scopes
+static void analyze_batch(void *arg) {
+    Analysis_Batch *batch = arg;
+    for (int i = batch->first; i < batch->end && !batch->err; i++) {
+        int function = batch->functions[i];
+        //like in a serial analysis, the body only sees the root symbols defined before the function
+        symbol_table_enter_reserved(batch->table, batch->scopes[i], batch->ast->nodes[function].token + 1);
+        batch->err = check_symbols(batch->ast, function + 1, flat_end(batch->ast, function), batch->table);
+    }
+}
+
+int semantic_analysis_parallel(Flat_AST *ast, Symbol_Table *table, Thread_Pool *pool) {
+    int thread_count = pool == NULL ? 1 : pool->thread_count;
+    if (thread_count <= 1 || ast->count < 2 * PARALLEL_MIN_BATCH_NODES || flat_kind(ast, 0) != ND_ROOT) {
+        return semantic_analysis(ast, table);
+    }
+
+    //silent copy of the tokens for both phases, errors are reported by the serial fallback
+    Token_List *tokens = table->tokens;
+    Source silent_source = *tokens->source;
+    silent_source.silent = 1;
+    Token_List silent_tokens = *tokens;
+    silent_tokens.source = &silent_source;
+    table->tokens = &silent_tokens;
+
+    symbol_table_init_resolved(table, ast->count);
+    symbol_table_resolve(table, 0, NULL);
+    //the scope array must not move while the batches add their scopes
+    symbol_table_reserve_scopes(table, 1 + count_scopes(ast, 0));
+    int statement_count = ast->nodes[0].payload;
+    int *functions = malloc(statement_count * sizeof(int));
+    int *scopes = malloc(statement_count * sizeof(int));
+    int function_count = declare_top_level(ast, table, functions, scopes);
+    int failed = function_count < 0;
+
+    if (!failed) {
+        //split the bodies into batches of consecutive functions with roughly the same amount of nodes
+        long body_nodes = 0;
+        for (int i = 0; i < function_count; i++) {
+            body_nodes += ast->nodes[functions[i]].size;
+        }
+        long batch_size = body_nodes / (thread_count * BATCHES_PER_THREAD);
+        if (batch_size < PARALLEL_MIN_BATCH_NODES) {
+            batch_size = PARALLEL_MIN_BATCH_NODES;
+        }
+        Analysis_Batch *batches = malloc((function_count + 1) * sizeof(Analysis_Batch));
+        int batch_count = 0;
+        int first = 0;
+        while (first < function_count) {
+            int end = first;
+            long nodes = 0;
+            while (end < function_count && nodes < batch_size) {
+                nodes += ast->nodes[functions[end]].size;
+                end += 1;
+            }
+            Analysis_Batch *batch = &batches[batch_count];
+            batch->ast = ast;
+            batch->table = symbol_table_view(table, &silent_tokens, new_arena(table->arena->block_size, table->arena->flags));
+            batch->functions = functions;
+            batch->scopes = scopes;
+            batch->first = first;
+            batch->end = end;
+            batch->err = 0;
+            thread_pool_submit(pool, analyze_batch, batch);
+            batch_count += 1;
+            first = end;
+        }
+        thread_pool_wait(pool);
+        for (int i = 0; i < batch_count; i++) {
+            failed |= batches[i].err;
+            //the symbols and scopes of the batch stay valid and are released with the table
+            arena_merge(table->arena, batches[i].table->arena);
+        }
+        free(batches);
+    }
+    free(functions);
+    free(scopes);
+    table->tokens = tokens;
+
+    if (failed) {
+        //analyze again serially, so the first error in source order is reported
+        symbol_table_clear(table);
+        return semantic_analysis(ast, table);
+    }
+    return 0;
+}
+
+//incremental analysis
+
+//a cached function is an array of ints: the header, the parent of every scope of the body, the symbols defined in the body,
+//the outer names it refers to and the resolution of every node of the body (all after the function definition itself)
+//scopes are relative to the body scope and tokens relative to the name of the function,
+//so an entry applies to the same function at any position in any source
+typedef struct {
+    int node_count, scope_count, symbol_count, dependency_count;
+} Cached_Function;
+
+typedef struct {
+    int type, name, scope;
+} Cached_Symbol;
+
+//name of a root symbol the body refers to (a token inside of the body) and the type it needs to have
+typedef struct {
+    int name, type;
+} Cached_Dependency;
+
+//the node does not refer to a symbol
+#define CACHED_NO_SYMBOL -1
+
+typedef struct {
+    //scope of the node, NO_SCOPE if the node was not analyzed
+    int scope;
+    //index of a symbol of the body, symbol_count + index of a dependency or CACHED_NO_SYMBOL
+    int symbol;
+} Cached_Resolution;
+
+//views into a cached function
+typedef struct {
+    const Cached_Function *header;
+    const int *parents;
+    const Cached_Symbol *symbols;
+    const Cached_Dependency *dependencies;
+    const Cached_Resolution *resolutions;
+} Cached_Parts;
+
+#define cached_size(scope_count, symbol_count, dependency_count, node_count) \
+    ((sizeof(Cached_Function) + (symbol_count) * sizeof(Cached_Symbol) + (dependency_count) * sizeof(Cached_Dependency) \
+        + ((node_count) - 1) * sizeof(Cached_Resolution)) / sizeof(int) + (scope_count))
+
+typedef struct {
+    Analysis_Cache *cache;
+    //scratch map from token to the index of the symbol (or dependency) named by that token, -1 for all other tokens
+    int *token_slots;
+    //scratch array of the function that is currently restored
+    Symbol **symbols;
+    int symbol_capacity;
+    //restore bodies from the cache, cleared to check every body again (after an invalid entry)
+    int reuse;
+    int reused, analyzed;
+} Incremental_State;
+
+static Cached_Parts cached_parts(const int *entry) {
+    Cached_Parts parts;
+    parts.header = (const Cached_Function *) entry;
+    parts.parents = entry + sizeof(Cached_Function) / sizeof(int);
+    parts.symbols = (const Cached_Symbol *) (parts.parents + parts.header->scope_count);
+    parts.dependencies = (const Cached_Dependency *) (parts.symbols + parts.header->symbol_count);
+    parts.resolutions = (const Cached_Resolution *) (parts.dependencies + parts.header->dependency_count);
+    return parts;
+}
+
+//last token of the subtree of node
+static int last_token(Flat_AST *ast, int node) {
+    //the last node in pre-order is the last one in the source, unless it has no token (e.g. an empty case of a condition)
+    int last = ast->nodes[flat_end(ast, node) - 1].token;
+    if (last == NO_TOKEN) {
+        for (int i = node; i < flat_end(ast, node); i++) {
+            if (ast->nodes[i].token > last) {
+                last = ast->nodes[i].token;
+            }
+        }
+    }
+    return last;
+}
+
+//hash of everything the analysis of a body depends on, except for the outer names: the source text of all of its tokens
+//(identical text means identical tokens at the same relative positions and an identical subtree)
+static unsigned long long function_fingerprint(Flat_AST *ast, Token_List *tokens, int function) {
+    int first = ast->nodes[function].token;
+    int last = last_token(ast, function);
+    const char *text = token_value(tokens, first);
+    long size = tokens->offsets[last] + tokens->lengths[last] - tokens->offsets[first];
+    unsigned long long hash = ((unsigned long long) ast->nodes[function].size << 32) ^ size;
+    long i = 0;
+    for (; i + 8 <= size; i += 8) {
+        unsigned long long word;
+        memcpy(&word, text + i, 8);
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 29;
+    }
+    unsigned long long word = 0;
+    memcpy(&word, text + i, size - i);
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+    return hash ^ (hash >> 32);
+}
+
+//store the results of a freshly analyzed function in the cache
+static void cache_function(Flat_AST *ast, Symbol_Table *table, Incremental_State *state, unsigned long long fingerprint, int function, int body, int scope_count) {
+    int base = ast->nodes[function].token;
+    int node_count = ast->nodes[function].size;
+    int *token_slots = state->token_slots;
+    //number the symbols of the body in the order of their scopes, and the distinct root symbols the body refers to
+    int symbol_count = 0;
+    for (int i = body; i < body + scope_count; i++) {
+        for (Collection_Container *container = table->scopes[i].symbols->root; container != NULL; container = container->next) {
+            token_slots[((Symbol *) container->item)->name] = symbol_count;
+            symbol_count += 1;
+        }
+    }
+    int dependency_count = 0;
+    for (int node = function + 1; node < function + node_count; node++) {
+        Symbol *sym = resolved_symbol(table, node);
+        if (sym != NULL && sym->scope == ROOT_SCOPE && token_slots[sym->name] == -1) {
+            token_slots[sym->name] = symbol_count + dependency_count;
+            dependency_count += 1;
+        }
+    }
+
+    int *entry = analysis_cache_add(state->cache, fingerprint, cached_size(scope_count, symbol_count, dependency_count, node_count));
+    Cached_Function *header = (Cached_Function *) entry;
+    header->node_count = node_count;
+    header->scope_count = scope_count;
+    header->symbol_count = symbol_count;
+    header->dependency_count = dependency_count;
+    Cached_Parts parts = cached_parts(entry);
+    int *parents = (int *) parts.parents;
+    Cached_Symbol *symbols = (Cached_Symbol *) parts.symbols;
+    Cached_Dependency *dependencies = (Cached_Dependency *) parts.dependencies;
+    Cached_Resolution *resolutions = (Cached_Resolution *) parts.resolutions;
+
+    for (int i = body; i < body + scope_count; i++) {
+        parents[i - body] = i == body ? NO_SCOPE : table->scopes[i].parent - body;
+        for (Collection_Container *container = table->scopes[i].symbols->root; container != NULL; container = container->next) {
+            Symbol *sym = container->item;
+            Cached_Symbol *cached = &symbols[token_slots[sym->name]];
+            cached->type = sym->type;
+            cached->name = sym->name - base;
+            cached->scope = i - body;
+        }
+    }
+    for (int node = function + 1; node < function + node_count; node++) {
+        Cached_Resolution *resolution = &resolutions[node - function - 1];
+        int scope = resolved_scope(table, node);
+        Symbol *sym = resolved_symbol(table, node);
+        resolution->scope = scope == NO_SCOPE ? NO_SCOPE : scope - body;
+        resolution->symbol = sym == NULL ? CACHED_NO_SYMBOL : token_slots[sym->name];
+        if (sym != NULL && sym->scope == ROOT_SCOPE) {
+            //the name of a root symbol is outside of the body, refer to it by the name token of the node
+            //(an assignment has no name token of its own, its variable has)
+            Cached_Dependency *dependency = &dependencies[resolution->symbol - symbol_count];
+            int name = flat_kind(ast, node) == ND_ASSIGN ? ast->nodes[flat_lhs(ast, node)].token : ast->nodes[node].token;
+            dependency->name = name - base;
+            dependency->type = sym->type;
+        }
+    }
+
+    //leave the scratch map empty for the next function
+    for (int i = 0; i < symbol_count; i++) {
+        token_slots[base + symbols[i].name] = -1;
+    }
+    for (int node = function + 1; node < function + node_count; node++) {
+        Symbol *sym = resolved_symbol(table, node);
+        if (sym != NULL) {
+            token_slots[sym->name] = -1;
+        }
+    }
+}
+
+//check that a cached entry fits the function, so a corrupt entry (or a fingerprint collision) cannot break the table
+static int entry_fits(Flat_AST *ast, Symbol_Table *table, int function, const int *entry, int size) {
+    const Cached_Function *header = (const Cached_Function *) entry;
+    if (size < (int) (sizeof(Cached_Function) / sizeof(int))
+        || header->node_count != ast->nodes[function].size
+        || header->scope_count < 1
+        || header->symbol_count < 0
+        || header->dependency_count < 0
+        || size != (int) cached_size(header->scope_count, header->symbol_count, header->dependency_count, header->node_count)) {
+        return 0;
+    }
+    Cached_Parts parts = cached_parts(entry);
+    int scope_count = header->scope_count;
+    int token_count = table->tokens->count - ast->nodes[function].token;
+    for (int i = 1; i < scope_count; i++) {
+        if (parts.parents[i] < 0 || parts.parents[i] >= i) return 0;
+    }
+    for (int i = 0; i < header->symbol_count; i++) {
+        const Cached_Symbol *symbol = &parts.symbols[i];
+        if (symbol->scope < 0 || symbol->scope >= scope_count || symbol->name <= 0 || symbol->name >= token_count) return 0;
+        if (symbol->type != SYM_INT && symbol->type != SYM_FUNC) return 0;
+    }
+    for (int i = 0; i < header->dependency_count; i++) {
+        if (parts.dependencies[i].name <= 0 || parts.dependencies[i].name >= token_count) return 0;
+    }
+    //the resolutions are checked while they are restored
+    return 1;
+}
+
+//restore the results of a function from its cached entry, unless the outer names the body depends on changed:
+//every symbol defined in the body must not be visible in the root scope (its name was not found when it was defined)
+//and every root symbol the body refers to must still be visible with the same type
+//the function is already declared and the current scope is the root scope, which it is again afterwards
+//return 1 (without changing the table) if the entry does not apply, -1 if a resolution of the entry is invalid
+static int restore_function(Flat_AST *ast, Symbol_Table *table, Incremental_State *state, int function, const int *entry) {
+    Cached_Parts parts = cached_parts(entry);
+    const Cached_Function *header = parts.header;
+    int base = ast->nodes[function].token;
+    int reference_count = header->symbol_count + header->dependency_count;
+    if (reference_count > state->symbol_capacity) {
+        state->symbol_capacity = reference_count * 2;
+        state->symbols = realloc(state->symbols, state->symbol_capacity * sizeof(Symbol *));
+    }
+    Symbol **references = state->symbols;
+
+    for (int i = 0; i < header->symbol_count; i++) {
+        if (symbol_table_get(table, base + parts.symbols[i].name) != NULL) return 1;
+    }
+    for (int i = 0; i < header->dependency_count; i++) {
+        Symbol *sym = symbol_table_get(table, base + parts.dependencies[i].name);
+        if (sym == NULL || (int) sym->type != parts.dependencies[i].type) return 1;
+        references[header->symbol_count + i] = sym;
+    }
+
+    //scopes in pre-order, like the pushes of check_symbols
+    symbol_table_push(table);
+    int body = table->current;
+    for (int i = 1; i < header->scope_count; i++) {
+        symbol_table_enter(table, body + parts.parents[i]);
+        symbol_table_push(table);
+    }
+    for (int i = 0; i < header->symbol_count; i++) {
+        const Cached_Symbol *cached = &parts.symbols[i];
+        references[i] = new_symbol(table->arena, cached->type, base + cached->name);
+        symbol_table_enter(table, body + cached->scope);
+        symbol_table_set(table, references[i]);
+    }
+    symbol_table_reset_current(table);
+    //written in place, this loop runs for every node of every reused body
+    Resolution *resolved = table->resolved + function + 1;
+    const Flat_Node *nodes = ast->nodes + function + 1;
+    //symbols of the body defined by a node (their first assignment or their definition), that has to be all of them
+    int defined = 0;
+    for (int i = 0; i < header->node_count - 1; i++) {
+        const Cached_Resolution *resolution = &parts.resolutions[i];
+        if (resolution->scope < NO_SCOPE || resolution->scope >= header->scope_count
+            || resolution->symbol < CACHED_NO_SYMBOL || resolution->symbol >= reference_count) {
+            return -1;
+        }
+        //names have to resolve to a symbol of their type (like check_symbols does), all other nodes to none
+        Symbol *symbol = resolution->symbol == CACHED_NO_SYMBOL ? NULL : references[resolution->symbol];
+        int kind = nodes[i].kind;
+        if (kind == ND_VAR || kind == ND_ASSIGN || kind == ND_FUNCTION_CALL || kind == ND_FUNCTION_DEF) {
+            Symbol_Type type = kind == ND_VAR || kind == ND_ASSIGN ? SYM_INT : SYM_FUNC;
+            if (resolution->scope == NO_SCOPE || symbol == NULL || symbol->type != type) return -1;
+        }
+        else if (symbol != NULL) {
+            return -1;
+        }
+        if (kind == ND_ASSIGN) {
+            //an assignment refers to the symbol of its variable, which comes right after it (and is restored next)
+            const Cached_Resolution *variable = &parts.resolutions[i + 1];
+            if (variable->symbol != resolution->symbol) return -1;
+            defined += resolution->symbol < header->symbol_count && symbol->name == nodes[i + 1].token;
+        }
+        else if (kind == ND_FUNCTION_DEF) {
+            defined += resolution->symbol < header->symbol_count && symbol->name == nodes[i].token;
+        }
+        if (resolution->scope != NO_SCOPE) {
+            resolved[i].symbol = symbol;
+            resolved[i].scope = body + resolution->scope;
+        }
+    }
+    //nodes have distinct tokens, so this only holds if every symbol of the body is defined by exactly one node
+    if (defined != header->symbol_count) return -1;
+    return 0;
+}
+
+//declare a top-level function and restore its body from the cache or check it (and add it to the cache)
+//return 1 on error, -1 if the cache entry of the function was invalid
+static int analyze_function(Flat_AST *ast, Symbol_Table *table, Incremental_State *state, int function) {
+    symbol_table_resolve(table, function, NULL);
+    int err = declare_function(ast, function, table);
+    if (err) return err;
+
+    unsigned long long fingerprint = function_fingerprint(ast, table->tokens, function);
+    int size;
+    const int *entry = state->reuse ? analysis_cache_get(state->cache, fingerprint, &size) : NULL;
+    if (entry != NULL && entry_fits(ast, table, function, entry, size)) {
+        int restored = restore_function(ast, table, state, function, entry);
+        if (restored == 0) {
+            analysis_cache_keep(state->cache, fingerprint, entry, size);
+            state->reused += 1;
+            return 0;
+        }
+        //an invalid entry is not kept, the body is checked again and its new entry replaces it
+        if (restored < 0) return -1;
+    }
+
+    symbol_table_push(table);
+    int body = table->current;
+    err = check_symbols(ast, function + 1, flat_end(ast, function), table);
+    if (err) return err;
+    symbol_table_pop(table);
+    if (state->token_slots == NULL) {
+        state->token_slots = malloc(table->tokens->count * sizeof(int));
+        memset(state->token_slots, -1, table->tokens->count * sizeof(int));
+    }
+    cache_function(ast, table, state, fingerprint, function, body, table->scope_count - body);
+    state->analyzed += 1;
+    return 0;
+}
+
+//analyze all top-level statements in the same order as semantic_analysis,
+//so the root scope only contains the symbols defined before the current function
+//return 1 on error, -1 if a cache entry was invalid
+static int analyze_statements(Flat_AST *ast, Symbol_Table *table, Incremental_State *state) {
+    symbol_table_init_resolved(table, ast->count);
+    symbol_table_resolve(table, 0, NULL);
+    state->reused = 0;
+    state->analyzed = 0;
+    int err = 0;
+    int statement = 1;
+    while (!err && statement < ast->count) {
+        if (flat_kind(ast, statement) == ND_FUNCTION_DEF) {
+            err = analyze_function(ast, table, state, statement);
+        }
+        else {
+            err = check_symbols(ast, statement, flat_end(ast, statement), table);
+        }
+        statement = flat_end(ast, statement);
+    }
+    return err;
+}
+
+int semantic_analysis_incremental(Flat_AST *ast, Symbol_Table *table, Analysis_Cache *cache, int *reused, int *analyzed) {
+    if (ast->count == 0 || flat_kind(ast, 0) != ND_ROOT) {
+        printf("INTERNAL ERROR: AST has no root node\n");
+        return 1;
+    }
+
+    Incremental_State state;
+    state.cache = cache;
+    state.token_slots = NULL;
+    state.symbols = NULL;
+    state.symbol_capacity = 0;
+    state.reuse = 1;
+    int err = analyze_statements(ast, table, &state);
+    if (err < 0) {
+        //a half restored function cannot be checked again, start over and check every body (which also replaces the invalid entry)
+        symbol_table_clear(table);
+        analysis_cache_reset(cache);
+        state.reuse = 0;
+        err = analyze_statements(ast, table, &state);
+    }
+    free(state.token_slots);
+    free(state.symbols);
+    *reused = state.reused;
+    *analyzed = state.analyzed;
+    return err;
 }
@@ -1,4 +1,17 @@
-#include "parser.h"
+#include "flat.h"
 #include "symbol.h"
+#include "pool.h"
+#include "cache.h"
 
-int semantic_analysis(AST_Node *ast_root, Symbol_Table *table);
+int semantic_analysis(Flat_AST *ast, Symbol_Table *table);
+
+//like semantic_analysis, but check the bodies of top-level functions in parallel on the threads of the pool
+//the declarations of all top-level statements are checked serially first, errors are reported in source order
+//the resulting symbols, scopes and resolutions are identical to the ones of semantic_analysis (small inputs are analyzed serially)
+int semantic_analysis_parallel(Flat_AST *ast, Symbol_Table *table, Thread_Pool *pool);
+
+//like semantic_analysis, but restore the results of a top-level function body from cache if neither the body
+//(structure and tokens) nor the outer names it refers to changed, only the other bodies are checked again
+//the results of all bodies are added to cache for the next compilation (see store_analysis_cache)
+//the amount of reused and checked bodies is stored in reused and analyzed
+int semantic_analysis_incremental(Flat_AST *ast, Symbol_Table *table, Analysis_Cache *cache, int *reused, int *analyzed);
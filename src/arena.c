@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "arena.h"
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+//space reserved for the block header, keeps the first object aligned
+#define BLOCK_HEADER_SIZE ((sizeof(Arena_Block) + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1))
+
+Arena *new_arena(size_t block_size, Arena_Flags flags) {
+    Arena *arena = malloc(sizeof(Arena));
+    arena->block = NULL;
+    arena->next = NULL;
+    arena->end = NULL;
+    arena->block_size = block_size;
+    arena->flags = flags;
+    arena->bytes = 0;
+    arena->objects = 0;
+    arena->blocks = 0;
+    arena->reserved = 0;
+    return arena;
+}
+
+void free_arena(Arena *arena) {
+    Arena_Block *block = arena->block;
+    while (block != NULL) {
+        Arena_Block *previous = block->previous;
+        munmap(block, block->size);
+        block = previous;
+    }
+    free(arena);
+}
+
+void *arena_alloc_block(Arena *arena, size_t size) {
+    //objects larger than a block get a block of their own
+    size_t block_size = arena->block_size;
+    if (block_size < BLOCK_HEADER_SIZE + size) {
+        block_size = BLOCK_HEADER_SIZE + size;
+    }
+    if (arena->flags & ARENA_HUGE_PAGES) {
+        block_size = (block_size + HUGE_PAGE_SIZE - 1) & ~(size_t) (HUGE_PAGE_SIZE - 1);
+    }
+    Arena_Block *block = mmap(NULL, block_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED) {
+        printf("ERROR: out of memory!\n");
+        exit(1);
+    }
+#ifdef MADV_HUGEPAGE
+    if (arena->flags & ARENA_HUGE_PAGES) {
+        //only a hint, the kernel falls back to regular pages
+        madvise(block, block_size, MADV_HUGEPAGE);
+    }
+#endif
+    block->size = block_size;
+    block->previous = arena->block;
+    arena->block = block;
+    arena->next = (char *) block + BLOCK_HEADER_SIZE;
+    arena->end = (char *) block + block_size;
+    arena->blocks += 1;
+    arena->reserved += block_size;
+
+    void *object = arena->next;
+    arena->next += size;
+    arena->bytes += size;
+    arena->objects += 1;
+    return object;
+}
+
+void arena_merge(Arena *arena, Arena *other) {
+    if (other->block != NULL) {
+        //append the blocks of other behind the current block, so allocations keep bumping through it
+        Arena_Block *oldest = other->block;
+        while (oldest->previous != NULL) {
+            oldest = oldest->previous;
+        }
+        if (arena->block == NULL) {
+            arena->block = other->block;
+            arena->next = other->next;
+            arena->end = other->end;
+        }
+        else {
+            oldest->previous = arena->block->previous;
+            arena->block->previous = other->block;
+        }
+    }
+    arena->bytes += other->bytes;
+    arena->objects += other->objects;
+    arena->blocks += other->blocks;
+    arena->reserved += other->reserved;
+    free(other);
+}
+
+void arena_print_stats(Arena *arena, char *name) {
+    printf("%s: %zu objects, %zu bytes used, %zu bytes reserved in %zu blocks\n", name, arena->objects, arena->bytes, arena->reserved, arena->blocks);
+}
@@ -0,0 +1,65 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+//bump pointer allocator for the small, long lived objects of a compiler step (AST nodes, symbols, scopes, ...)
+//objects are never freed one by one, the whole arena is released at once
+//important: not thread safe, use one arena per thread
+
+//default size of the memory blocks the arena bumps through
+#define ARENA_BLOCK_SIZE (64 * 1024)
+//alignment of every allocation
+#define ARENA_ALIGNMENT 16
+
+typedef enum {
+    ARENA_DEFAULT = 0,
+    //back blocks with transparent huge pages (blocks are rounded up to 2 MB)
+    ARENA_HUGE_PAGES = 1,
+} Arena_Flags;
+
+//header at the start of every block, followed by the allocated objects
+typedef struct Arena_Block {
+    struct Arena_Block *previous;
+    size_t size;
+} Arena_Block;
+
+typedef struct {
+    //block that is currently bumped through, [next, end) is still free
+    Arena_Block *block;
+    char *next, *end;
+    size_t block_size;
+    Arena_Flags flags;
+    //statistics
+    size_t bytes, objects, blocks, reserved;
+} Arena;
+
+Arena *new_arena(size_t block_size, Arena_Flags flags);
+
+//release all blocks (and every object allocated from them)
+void free_arena(Arena *arena);
+
+//slow path of arena_alloc, allocates a new block
+void *arena_alloc_block(Arena *arena, size_t size);
+
+//uninitialized memory for size bytes, aligned to ARENA_ALIGNMENT
+static inline void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+    if (size > (size_t) (arena->end - arena->next)) {
+        return arena_alloc_block(arena, size);
+    }
+    void *object = arena->next;
+    arena->next += size;
+    arena->bytes += size;
+    arena->objects += 1;
+    return object;
+}
+
+//move all blocks (and counters) of other into arena and free other
+//objects of other stay valid and are released together with arena
+void arena_merge(Arena *arena, Arena *other);
+
+//print the counters of the arena, prefixed with name
+void arena_print_stats(Arena *arena, char *name);
+
+#endif
@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include "asm.h"
+
+//every instruction is indented by 4 spaces, labels are not indented
+#define INDENT "    "
+
+typedef struct {
+    const char *text;
+    int length;
+} Name;
+
+#define NAME(text) { text, sizeof(text) - 1 }
+
+//indexed by Register
+static const Name register_names[] = {
+    [REG_RAX] = NAME("rax"), [REG_RBX] = NAME("rbx"), [REG_RSP] = NAME("rsp"), [REG_RBP] = NAME("rbp"), [REG_RDI] = NAME("rdi"),
+};
+
+//indexed by Asm_Opcode, the indentation and the space before the first operand are included
+static const Name mnemonics[] = {
+    NAME(INDENT "mov "), NAME(INDENT "add "), NAME(INDENT "sub "), NAME(INDENT "cmp "),
+    NAME(INDENT "push "), NAME(INDENT "pop "), NAME(INDENT "jmp "), NAME(INDENT "je "), NAME(INDENT "jne "),
+    NAME(INDENT "call "), NAME(INDENT "ret"), NAME(INDENT "nop"), NAME(INDENT "syscall"),
+};
+
+Asm_Writer *new_asm_writer(Output_Buffer *text, Output_Buffer *code, int section, Code_Links *links) {
+    Asm_Writer *new = malloc(sizeof(Asm_Writer));
+    new->text = text;
+    new->code = code;
+    new->section = section;
+    new->links = links;
+    return new;
+}
+
+void free_asm_writer(Asm_Writer *writer) {
+    free(writer);
+}
+
+//number of label in the machine code
+//function labels and branch labels share their indices (mangle indices), so every index has two labels
+static int label_number(Label label) {
+    int second = label.kind == LABEL_FUNCTION_INNER || label.kind == LABEL_END;
+    return label.index * 2 + second;
+}
+
+static void write_name(Output_Buffer *out, Name name) {
+    output_bytes(out, name.text, name.length);
+}
+
+//size is only needed if no register operand determines it
+static void write_operand(Output_Buffer *out, Operand operand, int needs_size) {
+    if (operand.kind == OPERAND_REGISTER) {
+        write_name(out, register_names[operand.reg]);
+    }
+    else if (operand.kind == OPERAND_STACK) {
+        if (needs_size) {
+            output_literal(out, "qword ");
+        }
+        output_literal(out, "[rbp - ");
+        output_int(out, operand.value);
+        output_char(out, ']');
+    }
+    else {
+        output_int(out, operand.value);
+    }
+}
+
+static void write_label_name(Output_Buffer *out, Label label) {
+    if (label.kind == LABEL_ELSE) {
+        output_literal(out, "else_");
+        output_int(out, label.index);
+        return;
+    }
+    if (label.kind == LABEL_END) {
+        output_literal(out, "end_");
+        output_int(out, label.index);
+        return;
+    }
+    output_bytes(out, label.name, label.length);
+    output_char(out, '_');
+    output_int(out, label.index);
+    if (label.kind == LABEL_FUNCTION_INNER) {
+        output_literal(out, "_inner");
+    }
+}
+
+void asm_op0(Asm_Writer *out, Asm_Opcode opcode) {
+    if (out->text != NULL) {
+        write_name(out->text, mnemonics[opcode]);
+        output_char(out->text, '\n');
+    }
+    if (out->code != NULL) {
+        x86_op0(out->code, opcode);
+    }
+}
+
+void asm_op1(Asm_Writer *out, Asm_Opcode opcode, Operand operand) {
+    if (out->text != NULL) {
+        write_name(out->text, mnemonics[opcode]);
+        write_operand(out->text, operand, 1);
+        output_char(out->text, '\n');
+    }
+    if (out->code != NULL) {
+        x86_op1(out->code, opcode, operand);
+    }
+}
+
+void asm_op2(Asm_Writer *out, Asm_Opcode opcode, Operand dst, Operand src) {
+    if (out->text != NULL) {
+        write_name(out->text, mnemonics[opcode]);
+        write_operand(out->text, dst, src.kind == OPERAND_IMMEDIATE);
+        output_literal(out->text, ", ");
+        write_operand(out->text, src, 0);
+        output_char(out->text, '\n');
+    }
+    if (out->code != NULL) {
+        x86_op2(out->code, opcode, dst, src);
+    }
+}
+
+void asm_jump(Asm_Writer *out, Asm_Opcode opcode, Label label) {
+    if (out->text != NULL) {
+        write_name(out->text, mnemonics[opcode]);
+        write_label_name(out->text, label);
+        output_char(out->text, '\n');
+    }
+    if (out->code != NULL) {
+        x86_jump(out->code, out->links, out->section, opcode, label_number(label));
+    }
+}
+
+void asm_label(Asm_Writer *out, Label label) {
+    if (out->text != NULL) {
+        write_label_name(out->text, label);
+        output_literal(out->text, ":\n");
+    }
+    if (out->code != NULL) {
+        x86_label(out->code, out->links, out->section, label_number(label));
+    }
+}
+
+void asm_blank(Asm_Writer *out) {
+    if (out->text != NULL) {
+        output_char(out->text, '\n');
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef ASM_H
+#define ASM_H
+
+#include "output.h"
+#include "x86.h"
+
+//instruction level writer for x86-64 code
+//every instruction is written as assembly text (nasm syntax), as machine code or as both
+//operands and labels of the text are formatted by hand, nothing on this path goes through printf
+
+typedef enum {
+    //name_index, name_index_inner
+    LABEL_FUNCTION, LABEL_FUNCTION_INNER,
+    //else_index, end_index (branches of a condition)
+    LABEL_ELSE, LABEL_END,
+} Label_Kind;
+
+typedef struct {
+    Label_Kind kind;
+    //name of a function label (not null terminated)
+    const char *name;
+    int length;
+    int index;
+} Label;
+
+//destination of the instructions of one section of the code (the main code or one function)
+typedef struct {
+    //assembly text, NULL to skip
+    Output_Buffer *text;
+    //machine code, NULL to skip
+    Output_Buffer *code;
+    //index of the section and labels/jumps of all sections (only used for machine code)
+    int section;
+    Code_Links *links;
+} Asm_Writer;
+
+//writer of the given buffers (either can be NULL), the writer does not own them
+Asm_Writer *new_asm_writer(Output_Buffer *text, Output_Buffer *code, int section, Code_Links *links);
+
+void free_asm_writer(Asm_Writer *writer);
+
+static inline Operand asm_register(Register reg) {
+    return (Operand) { OPERAND_REGISTER, reg, 0 };
+}
+
+static inline Operand asm_stack(long offset) {
+    return (Operand) { OPERAND_STACK, 0, offset };
+}
+
+static inline Operand asm_immediate(long value) {
+    return (Operand) { OPERAND_IMMEDIATE, 0, value };
+}
+
+//instruction without operands (ret, nop, syscall)
+void asm_op0(Asm_Writer *out, Asm_Opcode opcode);
+
+//instruction with a single operand (push, pop)
+void asm_op1(Asm_Writer *out, Asm_Opcode opcode, Operand operand);
+
+//instruction with a destination and a source operand (mov, add, sub, cmp)
+void asm_op2(Asm_Writer *out, Asm_Opcode opcode, Operand dst, Operand src);
+
+//jump or call to label
+void asm_jump(Asm_Writer *out, Asm_Opcode opcode, Label label);
+
+//define label at the current position
+void asm_label(Asm_Writer *out, Label label);
+
+//empty line, only for readability
+void asm_blank(Asm_Writer *out);
+
+#endif
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+
+//a call needs a return address, nesting deeper than this overflows the stack of a native program as well
+#define MAX_CALL_DEPTH (1024 * 1024)
+
+Bytecode *new_bytecode() {
+    Bytecode *new = malloc(sizeof(Bytecode));
+    new->code = NULL;
+    new->count = 0;
+    new->capacity = 0;
+    new->constants = NULL;
+    new->constant_count = 0;
+    new->constant_capacity = 0;
+    new->var_slot_count = 0;
+    return new;
+}
+
+void free_bytecode(Bytecode *bytecode) {
+    free(bytecode->code);
+    free(bytecode->constants);
+    free(bytecode);
+}
+
+int bytecode_emit(Bytecode *bytecode, Opcode opcode, int a, int b, int c) {
+    if (bytecode->count == bytecode->capacity) {
+        bytecode->capacity = bytecode->capacity == 0 ? 64 : bytecode->capacity * 2;
+        bytecode->code = realloc(bytecode->code, bytecode->capacity * sizeof(Instruction));
+    }
+    bytecode->code[bytecode->count] = (Instruction) { opcode, a, b, c };
+    bytecode->count += 1;
+    return bytecode->count - 1;
+}
+
+int bytecode_constant(Bytecode *bytecode, long value) {
+    if (bytecode->constant_count == bytecode->constant_capacity) {
+        bytecode->constant_capacity = bytecode->constant_capacity == 0 ? 64 : bytecode->constant_capacity * 2;
+        bytecode->constants = realloc(bytecode->constants, bytecode->constant_capacity * sizeof(long));
+    }
+    bytecode->constants[bytecode->constant_count] = value;
+    bytecode->constant_count += 1;
+    return bytecode->var_slot_count + bytecode->constant_count - 1;
+}
+
+long *new_bytecode_slots(Bytecode *bytecode) {
+    long *slots = calloc(bytecode->var_slot_count + bytecode->constant_count, sizeof(long));
+    memcpy(slots + bytecode->var_slot_count, bytecode->constants, bytecode->constant_count * sizeof(long));
+    return slots;
+}
+
+int bytecode_run(Bytecode *bytecode, long *slots) {
+    //threaded dispatch: every instruction jumps to the handler of the next one on its own (computed goto)
+    //instead of going back to a shared switch, which gives the branch predictor one indirect jump per handler
+    static void *handlers[] = {
+        [OP_MOVE] = &&op_move,
+        [OP_ADD] = &&op_add,
+        [OP_SUB] = &&op_sub,
+        [OP_JUMP] = &&op_jump,
+        [OP_JUMP_EQ] = &&op_jump_eq,
+        [OP_JUMP_NE] = &&op_jump_ne,
+        [OP_CALL] = &&op_call,
+        [OP_RET] = &&op_ret,
+        [OP_HALT] = &&op_halt,
+    };
+    #define dispatch() goto *handlers[pc->opcode]
+
+    Instruction *code = bytecode->code;
+    Instruction *pc = code;
+    //return addresses of the active calls
+    int call_capacity = 64;
+    Instruction **calls = malloc(call_capacity * sizeof(Instruction *));
+    int call_depth = 0;
+    int err = 0;
+    dispatch();
+
+op_move:
+    slots[pc->a] = slots[pc->b];
+    pc += 1;
+    dispatch();
+op_add:
+    //wraps around like the native code
+    slots[pc->a] = (long) ((unsigned long) slots[pc->b] + (unsigned long) slots[pc->c]);
+    pc += 1;
+    dispatch();
+op_sub:
+    slots[pc->a] = (long) ((unsigned long) slots[pc->b] - (unsigned long) slots[pc->c]);
+    pc += 1;
+    dispatch();
+op_jump:
+    pc = code + pc->a;
+    dispatch();
+op_jump_eq:
+    pc = slots[pc->a] == slots[pc->b] ? code + pc->c : pc + 1;
+    dispatch();
+op_jump_ne:
+    pc = slots[pc->a] != slots[pc->b] ? code + pc->c : pc + 1;
+    dispatch();
+op_call:
+    if (call_depth == call_capacity) {
+        if (call_capacity == MAX_CALL_DEPTH) {
+            printf("ERROR: program crashed (call stack overflow)\n");
+            err = 1;
+            goto op_halt;
+        }
+        call_capacity *= 2;
+        calls = realloc(calls, call_capacity * sizeof(Instruction *));
+    }
+    slots[pc->b] = call_depth;
+    calls[call_depth] = pc + 1;
+    call_depth += 1;
+    pc = code + pc->a;
+    dispatch();
+op_ret:
+    //like the native code restores the stack pointer saved on entry, a function that was entered again with a jump
+    //(from a nested function) returns to its original caller and not to the nested function
+    if (slots[pc->a] < 0 || slots[pc->a] >= call_depth) {
+        printf("ERROR: program crashed (return without a call)\n");
+        err = 1;
+        goto op_halt;
+    }
+    call_depth = slots[pc->a];
+    pc = calls[call_depth];
+    dispatch();
+op_halt:
+    #undef dispatch
+    free(calls);
+    return err;
+}
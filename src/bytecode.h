@@ -0,0 +1,56 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+//register based bytecode and its interpreter, runs a program without generating machine code
+//every operand is a slot: the variables use the slots of their symbol addr (see assign_addrs),
+//the constants of the program are stored in the slots after them
+
+typedef enum {
+    //a = b
+    OP_MOVE,
+    //a = b + c, a = b - c
+    OP_ADD, OP_SUB,
+    //jump to instruction a
+    OP_JUMP,
+    //jump to instruction c if a == b (or a != b)
+    OP_JUMP_EQ, OP_JUMP_NE,
+    //call the function at instruction a, the call depth before the call is stored in its slot b
+    //return behind the call the function with slot a was called from (the calls above it are dropped as well)
+    OP_CALL, OP_RET,
+    //end of the program
+    OP_HALT,
+} Opcode;
+
+typedef struct {
+    int opcode;
+    int a, b, c;
+} Instruction;
+
+typedef struct {
+    Instruction *code;
+    int count, capacity;
+    //values of the constant slots, in order of their slot
+    long *constants;
+    int constant_count, constant_capacity;
+    //slots of the variables, the constants start after them
+    int var_slot_count;
+} Bytecode;
+
+Bytecode *new_bytecode();
+
+void free_bytecode(Bytecode *bytecode);
+
+//append an instruction, return its index (jump targets can be patched through the code later)
+int bytecode_emit(Bytecode *bytecode, Opcode opcode, int a, int b, int c);
+
+//slot of a new constant (valid after var_slot_count is set)
+int bytecode_constant(Bytecode *bytecode, long value);
+
+//slots to run bytecode on, the variables start at 0 and the constants are filled in
+long *new_bytecode_slots(Bytecode *bytecode);
+
+//run bytecode from its first instruction until OP_HALT, the variables stay in slots afterwards
+//return 1 (after reporting the error) if the calls nest too deep
+int bytecode_run(Bytecode *bytecode, long *slots);
+
+#endif
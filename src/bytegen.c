@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bytegen.h"
+#include "codegen.h"
+#include "flat.h"
+#include "symbol.h"
+#include "bytecode.h"
+
+//state of the generation of one program
+typedef struct {
+    Compiler_Context *context;
+    Bytecode *bytecode;
+    //first instruction of every function body, indexed by mangle index (-1 until the definition is generated)
+    int *entries;
+    //calls and jumps to functions, their target is patched once all entries are known
+    int *function_jumps;
+    int function_jump_count, function_jump_capacity;
+} Bytegen;
+
+//first slot after all symbols (the variables of all scopes)
+int count_var_slots(Symbol_Table *table) {
+    int count = 0;
+    for (int id = 0; id < table->scope_count; id++) {
+        Scope *scope = symbol_table_scope(table, id);
+        for (Collection_Container *container = scope->symbols->root; container != NULL; container = container->next) {
+            Symbol *symbol = container->item;
+            if (symbol->addr + 1 > count) {
+                count = symbol->addr + 1;
+            }
+        }
+    }
+    return count;
+}
+
+//slot of a variable or of a new constant slot
+int value_slot(Bytegen *gen, int value) {
+    Compiler_Context *context = gen->context;
+    if (flat_kind(context->ast, value) == ND_VAR) {
+        return resolved_symbol(context->table, value)->addr;
+    }
+    return bytecode_constant(gen->bytecode, token_number(context->tokens, context->ast->nodes[value].token));
+}
+
+int gen_statements(Bytegen *gen, int statement, int end);
+
+void gen_assign(Bytegen *gen, int assignment) {
+    Flat_AST *ast = gen->context->ast;
+    int assignee = resolved_symbol(gen->context->table, assignment)->addr;
+    int expr = flat_rhs(ast, assignment);
+    AST_Node_Type kind = flat_kind(ast, expr);
+    //the slot of a new var is just written, it does not have to be allocated like a stack slot
+    if (kind == ND_ADD || kind == ND_SUB) {
+        int lhs = value_slot(gen, flat_lhs(ast, expr));
+        int rhs = value_slot(gen, flat_rhs(ast, expr));
+        bytecode_emit(gen->bytecode, kind == ND_ADD ? OP_ADD : OP_SUB, assignee, lhs, rhs);
+    }
+    else {
+        bytecode_emit(gen->bytecode, OP_MOVE, assignee, value_slot(gen, expr), 0);
+    }
+}
+
+//the body is generated in place, the code before it jumps over it
+int gen_function_def(Bytegen *gen, int function_def) {
+    Flat_AST *ast = gen->context->ast;
+    Symbol *symbol = resolved_symbol(gen->context->table, function_def);
+    int skip = bytecode_emit(gen->bytecode, OP_JUMP, 0, 0, 0);
+    gen->entries[symbol->mangle_index] = gen->bytecode->count;
+    int err = gen_statements(gen, function_def + 1, flat_end(ast, function_def));
+    if (err) return 1;
+    bytecode_emit(gen->bytecode, OP_RET, symbol->addr, 0, 0);
+    gen->bytecode->code[skip].a = gen->bytecode->count;
+    return 0;
+}
+
+//like the native code: functions of the current scope are called,
+//any other function (the enclosing one or one further out) is entered with a jump to the start of its body
+void gen_function_call(Bytegen *gen, int function_call) {
+    Symbol_Table *table = gen->context->table;
+    Symbol *symbol = resolved_symbol(table, function_call);
+    Opcode opcode = resolved_is_local(table, function_call) ? OP_CALL : OP_JUMP;
+    //the target is the mangle index until patch_function_jumps, the slot of the function holds the call depth of a call
+    int jump = bytecode_emit(gen->bytecode, opcode, symbol->mangle_index, symbol->addr, 0);
+    if (gen->function_jump_count == gen->function_jump_capacity) {
+        gen->function_jump_capacity = gen->function_jump_capacity == 0 ? 64 : gen->function_jump_capacity * 2;
+        gen->function_jumps = realloc(gen->function_jumps, gen->function_jump_capacity * sizeof(int));
+    }
+    gen->function_jumps[gen->function_jump_count] = jump;
+    gen->function_jump_count += 1;
+}
+
+int gen_condition(Bytegen *gen, int condition) {
+    Flat_AST *ast = gen->context->ast;
+    Bytecode *bytecode = gen->bytecode;
+    int boolean = flat_cond_bool(ast, condition);
+    int cond_true = flat_cond_true(ast, condition);
+    int cond_false = flat_cond_false(ast, condition);
+    int lhs = value_slot(gen, flat_lhs(ast, boolean));
+    int rhs = value_slot(gen, flat_rhs(ast, boolean));
+    //jump over the 'true-case' if the boolean is false
+    Opcode opcode = token_type(gen->context->tokens, ast->nodes[boolean].token) == TK_EQU ? OP_JUMP_NE : OP_JUMP_EQ;
+    int skip_true = bytecode_emit(bytecode, opcode, lhs, rhs, 0);
+    int err = gen_statements(gen, cond_true + 1, flat_end(ast, cond_true));
+    if (err) return 1;
+
+    if (cond_false != NO_NODE) {
+        int skip_false = bytecode_emit(bytecode, OP_JUMP, 0, 0, 0);
+        bytecode->code[skip_true].c = bytecode->count;
+        err = gen_statements(gen, cond_false + 1, flat_end(ast, cond_false));
+        if (err) return 1;
+        bytecode->code[skip_false].a = bytecode->count;
+    }
+    else {
+        bytecode->code[skip_true].c = bytecode->count;
+    }
+    return 0;
+}
+
+//generate the statements in [statement, end), end is the end of the parent subtree
+int gen_statements(Bytegen *gen, int statement, int end) {
+    Flat_AST *ast = gen->context->ast;
+    while (statement < end) {
+        AST_Node_Type kind = flat_kind(ast, statement);
+        int err = 0;
+        if (kind == ND_ASSIGN) {
+            gen_assign(gen, statement);
+        }
+        else if (kind == ND_FUNCTION_DEF) {
+            err = gen_function_def(gen, statement);
+        }
+        else if (kind == ND_FUNCTION_CALL) {
+            gen_function_call(gen, statement);
+        }
+        else if (kind == ND_COND) {
+            err = gen_condition(gen, statement);
+        }
+        else {
+            printf("ERROR: AST_Node is not a statement\n");
+            return 1;
+        }
+        if (err) return 1;
+        statement = flat_end(ast, statement);
+    }
+    return 0;
+}
+
+//replace the mangle index in the target of every call and jump to a function with its entry
+int patch_function_jumps(Bytegen *gen) {
+    for (int i = 0; i < gen->function_jump_count; i++) {
+        Instruction *jump = &gen->bytecode->code[gen->function_jumps[i]];
+        int entry = gen->entries[jump->a];
+        if (entry < 0) {
+            printf("INTERNAL ERROR: call of a function without body\n");
+            return 1;
+        }
+        jump->a = entry;
+    }
+    return 0;
+}
+
+int bytegen(Compiler_Context *context) {
+    Flat_AST *ast = context->ast;
+    if (ast->count == 0 || flat_kind(ast, 0) != ND_ROOT) {
+        printf("INTERNAL ERROR: AST has no root node\n");
+        return 1;
+    }
+
+    assign_addrs(context);
+    int function_count = context->mangle_index;
+    Bytegen gen = { context, new_bytecode(), malloc(function_count * sizeof(int)), NULL, 0, 0 };
+    for (int i = 0; i < function_count; i++) {
+        gen.entries[i] = -1;
+    }
+    gen.bytecode->var_slot_count = count_var_slots(context->table);
+    context->bytecode = gen.bytecode;
+
+    int err = gen_statements(&gen, 1, ast->count);
+    if (!err) {
+        bytecode_emit(gen.bytecode, OP_HALT, 0, 0, 0);
+        err = patch_function_jumps(&gen);
+    }
+    free(gen.entries);
+    free(gen.function_jumps);
+    return err;
+}
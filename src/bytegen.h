@@ -0,0 +1,10 @@
+#ifndef BYTEGEN_H
+#define BYTEGEN_H
+
+#include "compiler.h"
+
+//generate the bytecode of the analyzed AST of context into context->bytecode
+//the variables use the slots of their symbol addr, so the slot of a root variable holds its value after the run
+int bytegen(Compiler_Context *context);
+
+#endif
@@ -0,0 +1,501 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cache.h"
+
+#define CACHE_MAGIC "FCAST\0\0\0"
+#define ANALYSIS_CACHE_MAGIC "FCSEM\0\0\0"
+//every array starts at a multiple of this
+#define CACHE_ALIGNMENT 8
+
+unsigned long long source_hash(Source *source) {
+    const char *text = source->text;
+    long size = source->size;
+    unsigned long long hash = size;
+    long i = 0;
+    for (; i + 8 <= size; i += 8) {
+        unsigned long long word;
+        memcpy(&word, text + i, 8);
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 29;
+    }
+    unsigned long long word = 0;
+    memcpy(&word, text + i, size - i);
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+    return hash ^ (hash >> 32);
+}
+
+//DIR/<hash>.ast, the caller frees the path
+static char *cache_path(char *directory, unsigned long long hash) {
+    char *path = malloc(strlen(directory) + 32);
+    sprintf(path, "%s/%016llx.ast", directory, hash);
+    return path;
+}
+
+static unsigned long long align(unsigned long long offset) {
+    return (offset + CACHE_ALIGNMENT - 1) & ~(unsigned long long) (CACHE_ALIGNMENT - 1);
+}
+
+//check that the array [offset, offset + size) lies inside of the file
+static int in_file(unsigned long long offset, unsigned long long size, long file_size) {
+    return offset % CACHE_ALIGNMENT == 0 && offset <= (unsigned long long) file_size && size <= file_size - offset;
+}
+
+//every token has a known type and lies inside of the source
+static int tokens_fit(const Token_Type *types, const long *offsets, const int *lengths, unsigned int count, long source_size) {
+    for (unsigned int i = 0; i < count; i++) {
+        if ((unsigned int) types[i] >= TK_EOF || offsets[i] < 0 || lengths[i] < 0 || lengths[i] > source_size - offsets[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+#define kind_bit(kind) (1u << (kind))
+#define STATEMENT_KINDS (kind_bit(ND_ASSIGN) | kind_bit(ND_FUNCTION_DEF) | kind_bit(ND_FUNCTION_CALL) | kind_bit(ND_COND))
+#define SUMMAND_KINDS (kind_bit(ND_VAR) | kind_bit(ND_INT))
+
+//children and token a node of each kind needs (see the child order in flat.h and the grammar in parser.c)
+typedef struct {
+    //statement lists have any amount of statements as children (their payload is the amount), other kinds exactly child_count
+    int is_list;
+    int child_count;
+    //allowed kinds of each child, as bits of AST_Node_Type
+    unsigned int children[3];
+    //type of the token of the node, TK_EOF if it is not used
+    Token_Type token;
+} Node_Shape;
+
+static const Node_Shape node_shapes[] = {
+    [ND_ROOT] = { 1, 0, { STATEMENT_KINDS }, TK_EOF },
+    [ND_FUNCTION_DEF] = { 1, 0, { STATEMENT_KINDS }, TK_IDENT },
+    [ND_FUNCTION_CALL] = { 0, 0, { 0 }, TK_IDENT },
+    //the token is == or !=, checked separately
+    [ND_BOOLEAN] = { 0, 2, { SUMMAND_KINDS, SUMMAND_KINDS }, TK_EOF },
+    //plus ND_COND_FALSE with FLAT_HAS_ELSE
+    [ND_COND] = { 0, 2, { kind_bit(ND_BOOLEAN), kind_bit(ND_COND_TRUE), kind_bit(ND_COND_FALSE) }, TK_EOF },
+    [ND_COND_TRUE] = { 1, 0, { STATEMENT_KINDS }, TK_EOF },
+    [ND_COND_FALSE] = { 1, 0, { STATEMENT_KINDS }, TK_EOF },
+    [ND_ASSIGN] = { 0, 2, { kind_bit(ND_VAR), SUMMAND_KINDS | kind_bit(ND_ADD) | kind_bit(ND_SUB) }, TK_EOF },
+    [ND_INT] = { 0, 0, { 0 }, TK_NUM_LITERAL },
+    [ND_VAR] = { 0, 0, { 0 }, TK_IDENT },
+    [ND_ADD] = { 0, 2, { SUMMAND_KINDS, SUMMAND_KINDS }, TK_EOF },
+    [ND_SUB] = { 0, 2, { SUMMAND_KINDS, SUMMAND_KINDS }, TK_EOF },
+};
+
+//the nodes form a single tree below a root node that the later compiler steps can walk without any further checks:
+//known kinds, subtrees inside of their parent, the children every kind expects and tokens of the right type
+//every node is visited once as a node and once as the child of its parent, so the check is linear
+static int ast_fits(const Flat_Node *nodes, unsigned int count, const Token_Type *types, unsigned int token_count) {
+    if (count == 0 || nodes[0].kind != ND_ROOT || (unsigned int) nodes[0].size != count) {
+        return 0;
+    }
+    for (unsigned int i = 0; i < count; i++) {
+        const Flat_Node *node = &nodes[i];
+        if (node->kind > ND_SUB || node->size < 1 || (unsigned int) node->size > count - i
+            || node->token < NO_TOKEN || (node->token != NO_TOKEN && (unsigned int) node->token >= token_count)
+            || (node->flags & ~FLAT_HAS_ELSE) != 0 || (node->flags != 0 && node->kind != ND_COND)) {
+            return 0;
+        }
+        const Node_Shape *shape = &node_shapes[node->kind];
+        if (shape->token != TK_EOF && (node->token == NO_TOKEN || types[node->token] != shape->token)) {
+            return 0;
+        }
+        if (node->kind == ND_BOOLEAN && (node->token == NO_TOKEN || (types[node->token] != TK_EQU && types[node->token] != TK_NON_EQU))) {
+            return 0;
+        }
+        int expected = shape->child_count + (node->flags & FLAT_HAS_ELSE ? 1 : 0);
+        unsigned int end = i + node->size;
+        unsigned int child = i + 1;
+        int child_count = 0;
+        while (child < end) {
+            //the size of the child is checked when it is visited itself, here it only has to end inside of this node
+            unsigned int allowed = shape->is_list ? shape->children[0] : child_count < expected ? shape->children[child_count] : 0;
+            if ((kind_bit(nodes[child].kind) & allowed) == 0 || nodes[child].size < 1 || (unsigned int) nodes[child].size > end - child) {
+                return 0;
+            }
+            child += nodes[child].size;
+            child_count += 1;
+        }
+        if (shape->is_list ? node->payload != child_count : child_count != expected) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+Ast_Cache *load_ast_cache(char *directory, Source *source) {
+    unsigned long long hash = source_hash(source);
+    char *path = cache_path(directory, hash);
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < (long) sizeof(Cache_Header)) {
+        close(fd);
+        return NULL;
+    }
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+
+    const Cache_Header *header = mapping;
+    const char *base = mapping;
+    unsigned long long tokens = header->token_count, nodes = header->node_count;
+    int valid = memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) == 0
+        && header->version == CACHE_VERSION
+        && header->header_size == sizeof(Cache_Header)
+        && header->node_size == sizeof(Flat_Node)
+        && header->source_hash == hash
+        && header->source_size == (unsigned long long) source->size
+        && in_file(header->types_offset, tokens * sizeof(Token_Type), st.st_size)
+        && in_file(header->offsets_offset, tokens * sizeof(long), st.st_size)
+        && in_file(header->lengths_offset, tokens * sizeof(int), st.st_size)
+        && in_file(header->ids_offset, tokens * sizeof(int), st.st_size)
+        && in_file(header->nodes_offset, nodes * sizeof(Flat_Node), st.st_size);
+    //the arrays are used in place by all later steps, so everything they index with has to be in range as well
+    valid = valid
+        && tokens_fit((const Token_Type *) (base + header->types_offset), (const long *) (base + header->offsets_offset),
+            (const int *) (base + header->lengths_offset), header->token_count, source->size)
+        && ast_fits((const Flat_Node *) (base + header->nodes_offset), header->node_count,
+            (const Token_Type *) (base + header->types_offset), header->token_count);
+    if (!valid) {
+        munmap(mapping, st.st_size);
+        return NULL;
+    }
+
+    Ast_Cache *cache = malloc(sizeof(Ast_Cache));
+    cache->mapping = mapping;
+    cache->size = st.st_size;
+
+    Token_List *token_list = new_token_list();
+    token_list->types = (Token_Type *) (base + header->types_offset);
+    token_list->offsets = (long *) (base + header->offsets_offset);
+    token_list->lengths = (int *) (base + header->lengths_offset);
+    token_list->ids = (int *) (base + header->ids_offset);
+    token_list->count = header->token_count;
+    token_list->capacity = header->token_count;
+    token_list->source = source;
+    cache->tokens = token_list;
+
+    Flat_AST *ast = malloc(sizeof(Flat_AST));
+    ast->nodes = (Flat_Node *) (base + header->nodes_offset);
+    ast->count = header->node_count;
+    ast->capacity = header->node_count;
+    cache->ast = ast;
+    return cache;
+}
+
+//write size bytes, return 1 on failure
+static int write_all(int fd, const void *data, unsigned long long size) {
+    const char *bytes = data;
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written <= 0) {
+            return 1;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return 0;
+}
+
+//write the array at offset (padding the file up to it), pos is the current end of the file
+static int write_array(int fd, unsigned long long *pos, unsigned long long offset, const void *data, unsigned long long size) {
+    static const char padding[CACHE_ALIGNMENT] = { 0 };
+    if (write_all(fd, padding, offset - *pos)) return 1;
+    if (write_all(fd, data, size)) return 1;
+    *pos = offset + size;
+    return 0;
+}
+
+int store_ast_cache(char *directory, Source *source, Token_List *tokens, Flat_AST *ast) {
+    mkdir(directory, 0777);
+    unsigned long long hash = source_hash(source);
+    unsigned long long count = tokens->count;
+
+    Cache_Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.header_size = sizeof(Cache_Header);
+    header.node_size = sizeof(Flat_Node);
+    header.token_count = tokens->count;
+    header.node_count = ast->count;
+    header.source_hash = hash;
+    header.source_size = source->size;
+    header.types_offset = align(sizeof(Cache_Header));
+    header.offsets_offset = align(header.types_offset + count * sizeof(Token_Type));
+    header.lengths_offset = align(header.offsets_offset + count * sizeof(long));
+    header.ids_offset = align(header.lengths_offset + count * sizeof(int));
+    header.nodes_offset = align(header.ids_offset + count * sizeof(int));
+
+    //write to a temporary file and rename it, so concurrent compilations never map a half written cache
+    char *path = cache_path(directory, hash);
+    char *temp_path = malloc(strlen(path) + 32);
+    sprintf(temp_path, "%s.%d.tmp", path, getpid());
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    int err = fd == -1;
+    if (!err) {
+        unsigned long long pos = 0;
+        err = write_array(fd, &pos, 0, &header, sizeof(header))
+            || write_array(fd, &pos, header.types_offset, tokens->types, count * sizeof(Token_Type))
+            || write_array(fd, &pos, header.offsets_offset, tokens->offsets, count * sizeof(long))
+            || write_array(fd, &pos, header.lengths_offset, tokens->lengths, count * sizeof(int))
+            || write_array(fd, &pos, header.ids_offset, tokens->ids, count * sizeof(int))
+            || write_array(fd, &pos, header.nodes_offset, ast->nodes, (unsigned long long) ast->count * sizeof(Flat_Node));
+        err = close(fd) || err;
+        err = err || rename(temp_path, path);
+        if (err) {
+            unlink(temp_path);
+        }
+    }
+    free(temp_path);
+    free(path);
+    return err;
+}
+
+void free_ast_cache(Ast_Cache *cache) {
+    munmap(cache->mapping, cache->size);
+    free(cache->tokens);
+    free(cache->ast);
+    free(cache);
+}
+
+//analysis cache
+
+//DIR/analysis.cache, the caller frees the path
+static char *analysis_cache_path(char *directory) {
+    char *path = malloc(strlen(directory) + 32);
+    sprintf(path, "%s/analysis.cache", directory);
+    return path;
+}
+
+Analysis_Cache *load_analysis_cache(char *directory) {
+    Analysis_Cache *cache = malloc(sizeof(Analysis_Cache));
+    cache->mapping = NULL;
+    cache->size = 0;
+    cache->keys = NULL;
+    cache->starts = NULL;
+    cache->order = NULL;
+    cache->data = NULL;
+    cache->entry_count = 0;
+    cache->next = 0;
+    cache->entries = NULL;
+    cache->new_count = 0;
+    cache->new_capacity = 0;
+    cache->new_data = NULL;
+    cache->new_size = 0;
+    cache->new_data_capacity = 0;
+
+    char *path = analysis_cache_path(directory);
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd == -1) {
+        return cache;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < (long) sizeof(Analysis_Cache_Header)) {
+        close(fd);
+        return cache;
+    }
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return cache;
+    }
+
+    const Analysis_Cache_Header *header = mapping;
+    const char *base = mapping;
+    unsigned long long entries = header->entry_count;
+    //counts larger than the file would overflow the array sizes below
+    int valid = memcmp(header->magic, ANALYSIS_CACHE_MAGIC, sizeof(header->magic)) == 0
+        && header->version == ANALYSIS_CACHE_VERSION
+        && entries < st.st_size / sizeof(unsigned long long)
+        && header->data_size <= st.st_size / sizeof(int)
+        && in_file(header->keys_offset, entries * sizeof(unsigned long long), st.st_size)
+        && in_file(header->order_offset, entries * sizeof(unsigned int), st.st_size)
+        && in_file(header->starts_offset, (entries + 1) * sizeof(unsigned long long), st.st_size)
+        && in_file(header->data_offset, header->data_size * sizeof(int), st.st_size);
+    if (valid) {
+        //every entry has to lie inside of the data
+        const unsigned long long *starts = (const unsigned long long *) (base + header->starts_offset);
+        valid = starts[0] == 0 && starts[entries] == header->data_size;
+        const unsigned int *order = (const unsigned int *) (base + header->order_offset);
+        for (unsigned long long i = 0; valid && i < entries; i++) {
+            valid = starts[i] <= starts[i + 1] && starts[i + 1] - starts[i] <= INT_MAX && order[i] < entries;
+        }
+    }
+    if (!valid) {
+        munmap(mapping, st.st_size);
+        return cache;
+    }
+    cache->mapping = mapping;
+    cache->size = st.st_size;
+    cache->keys = (const unsigned long long *) (base + header->keys_offset);
+    cache->starts = (const unsigned long long *) (base + header->starts_offset);
+    cache->order = (const unsigned int *) (base + header->order_offset);
+    cache->data = (const int *) (base + header->data_offset);
+    cache->entry_count = header->entry_count;
+    return cache;
+}
+
+const int *analysis_cache_get(Analysis_Cache *cache, unsigned long long key, int *size) {
+    int entry = cache->next;
+    if (entry >= cache->entry_count || cache->keys[entry] != key) {
+        //binary search in the indices sorted by key
+        int low = 0, high = cache->entry_count;
+        while (low < high) {
+            int middle = low + (high - low) / 2;
+            if (cache->keys[cache->order[middle]] < key) {
+                low = middle + 1;
+            }
+            else {
+                high = middle;
+            }
+        }
+        if (low == cache->entry_count || cache->keys[cache->order[low]] != key) {
+            return NULL;
+        }
+        entry = cache->order[low];
+    }
+    cache->next = entry + 1;
+    *size = cache->starts[entry + 1] - cache->starts[entry];
+    return cache->data + cache->starts[entry];
+}
+
+static Analysis_Cache_Entry *analysis_cache_append(Analysis_Cache *cache, unsigned long long key, int size) {
+    if (cache->new_count == cache->new_capacity) {
+        cache->new_capacity = cache->new_capacity == 0 ? 64 : cache->new_capacity * 2;
+        cache->entries = realloc(cache->entries, cache->new_capacity * sizeof(Analysis_Cache_Entry));
+    }
+    Analysis_Cache_Entry *entry = &cache->entries[cache->new_count];
+    cache->new_count += 1;
+    entry->key = key;
+    entry->kept = NULL;
+    entry->start = 0;
+    entry->size = size;
+    return entry;
+}
+
+void analysis_cache_keep(Analysis_Cache *cache, unsigned long long key, const int *entry, int size) {
+    analysis_cache_append(cache, key, size)->kept = entry;
+}
+
+int *analysis_cache_add(Analysis_Cache *cache, unsigned long long key, int size) {
+    if (cache->new_size + size > cache->new_data_capacity) {
+        cache->new_data_capacity = cache->new_data_capacity == 0 ? 4096 : cache->new_data_capacity * 2;
+        if (cache->new_data_capacity < cache->new_size + size) {
+            cache->new_data_capacity = cache->new_size + size;
+        }
+        cache->new_data = realloc(cache->new_data, cache->new_data_capacity * sizeof(int));
+    }
+    Analysis_Cache_Entry *entry = analysis_cache_append(cache, key, size);
+    entry->start = cache->new_size;
+    cache->new_size += size;
+    return cache->new_data + entry->start;
+}
+
+void analysis_cache_reset(Analysis_Cache *cache) {
+    cache->new_count = 0;
+    cache->new_size = 0;
+}
+
+typedef struct {
+    unsigned long long key;
+    unsigned int index;
+} Key_Index;
+
+static int compare_keys(const void *a, const void *b) {
+    unsigned long long key_a = ((const Key_Index *) a)->key;
+    unsigned long long key_b = ((const Key_Index *) b)->key;
+    return (key_a > key_b) - (key_a < key_b);
+}
+
+//indices of the entries sorted by their keys
+static void sort_by_key(const Analysis_Cache_Entry *entries, unsigned int *order, unsigned long long count) {
+    Key_Index *sorted = malloc(count * sizeof(Key_Index) + 1);
+    for (unsigned long long i = 0; i < count; i++) {
+        sorted[i].key = entries[i].key;
+        sorted[i].index = i;
+    }
+    qsort(sorted, count, sizeof(Key_Index), compare_keys);
+    for (unsigned long long i = 0; i < count; i++) {
+        order[i] = sorted[i].index;
+    }
+    free(sorted);
+}
+
+int store_analysis_cache(char *directory, Analysis_Cache *cache) {
+    mkdir(directory, 0777);
+    unsigned long long count = cache->new_count;
+    unsigned long long *keys = malloc(count * sizeof(unsigned long long) + 1);
+    unsigned int *order = malloc(count * sizeof(unsigned int) + 1);
+    unsigned long long *starts = malloc((count + 1) * sizeof(unsigned long long));
+    starts[0] = 0;
+    for (unsigned long long i = 0; i < count; i++) {
+        keys[i] = cache->entries[i].key;
+        starts[i + 1] = starts[i] + cache->entries[i].size;
+    }
+    sort_by_key(cache->entries, order, count);
+
+    Analysis_Cache_Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ANALYSIS_CACHE_MAGIC, sizeof(header.magic));
+    header.version = ANALYSIS_CACHE_VERSION;
+    header.entry_count = count;
+    header.data_size = starts[count];
+    header.keys_offset = align(sizeof(Analysis_Cache_Header));
+    header.order_offset = align(header.keys_offset + count * sizeof(unsigned long long));
+    header.starts_offset = align(header.order_offset + count * sizeof(unsigned int));
+    header.data_offset = align(header.starts_offset + (count + 1) * sizeof(unsigned long long));
+
+    //same as the AST cache, readers only ever see a complete file
+    char *path = analysis_cache_path(directory);
+    char *temp_path = malloc(strlen(path) + 32);
+    sprintf(temp_path, "%s.%d.tmp", path, getpid());
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    int err = fd == -1;
+    if (!err) {
+        unsigned long long pos = 0;
+        err = write_array(fd, &pos, 0, &header, sizeof(header))
+            || write_array(fd, &pos, header.keys_offset, keys, count * sizeof(unsigned long long))
+            || write_array(fd, &pos, header.order_offset, order, count * sizeof(unsigned int))
+            || write_array(fd, &pos, header.starts_offset, starts, (count + 1) * sizeof(unsigned long long));
+        for (unsigned long long i = 0; !err && i < count; i++) {
+            Analysis_Cache_Entry *entry = &cache->entries[i];
+            err = write_array(fd, &pos, header.data_offset + starts[i] * sizeof(int), entry->kept != NULL ? entry->kept : cache->new_data + entry->start, entry->size * sizeof(int));
+        }
+        //without entries, the (empty) data still has to start inside of the file
+        err = err || write_array(fd, &pos, header.data_offset + header.data_size * sizeof(int), NULL, 0);
+        err = close(fd) || err;
+        err = err || rename(temp_path, path);
+        if (err) {
+            unlink(temp_path);
+        }
+    }
+    free(temp_path);
+    free(path);
+    free(keys);
+    free(order);
+    free(starts);
+    return err;
+}
+
+void free_analysis_cache(Analysis_Cache *cache) {
+    if (cache->mapping != NULL) {
+        munmap(cache->mapping, cache->size);
+    }
+    free(cache->entries);
+    free(cache->new_data);
+    free(cache);
+}
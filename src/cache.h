@@ -0,0 +1,112 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "lexer.h"
+#include "flat.h"
+
+//binary cache of the front end results (token stream and flat AST) of a source
+//the file is keyed by a content hash of the source and mapped read-only, the arrays are used in place without copies
+//all positions inside of the file are offsets relative to its start, so it does not matter where it is mapped
+
+//bump whenever the layout of the file, Token_Type, AST_Node_Type or Flat_Node changes
+#define CACHE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    unsigned int version;
+    //sizes of the stored structs, guards against layout changes without a version bump
+    unsigned int header_size, node_size;
+    unsigned int token_count, node_count;
+    unsigned long long source_hash, source_size;
+    //offsets of the arrays relative to the start of the file
+    unsigned long long types_offset, offsets_offset, lengths_offset, ids_offset, nodes_offset;
+} Cache_Header;
+
+typedef struct {
+    void *mapping;
+    long size;
+    //views into the mapping
+    //important: tokens and ast are read-only, only release them with free_ast_cache
+    Token_List *tokens;
+    Flat_AST *ast;
+} Ast_Cache;
+
+//64-bit content hash of the source text
+unsigned long long source_hash(Source *source);
+
+//map the cache file of source from directory, NULL if there is none (or it is stale or invalid)
+Ast_Cache *load_ast_cache(char *directory, Source *source);
+
+//write the cache file of source into directory, return 1 if it could not be written
+int store_ast_cache(char *directory, Source *source, Token_List *tokens, Flat_AST *ast);
+
+void free_ast_cache(Ast_Cache *cache);
+
+//per-function results of semantic analysis, keyed by a fingerprint of the function (see analysis.c)
+//the file DIR/analysis.cache holds the entries of the last compilation that used the directory
+//an entry is an array of ints, the cache does not look into it
+
+//bump whenever the layout of the file or of the entries changes
+#define ANALYSIS_CACHE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    unsigned int version;
+    unsigned int entry_count;
+    //in ints
+    unsigned long long data_size;
+    //offsets of the arrays relative to the start of the file: keys in the order the entries were added,
+    //the indices of the entries sorted by key, entry_count + 1 starts (entry i is data[starts[i], starts[i + 1])) and the data of all entries
+    unsigned long long keys_offset, order_offset, starts_offset, data_offset;
+} Analysis_Cache_Header;
+
+//entry of the current compilation
+typedef struct {
+    unsigned long long key;
+    //entry of the cache file that is kept, NULL if the entry is in the data of the new entries
+    const int *kept;
+    //position in the data of the new entries, in ints
+    long start;
+    int size;
+} Analysis_Cache_Entry;
+
+typedef struct {
+    //entries of the cache file (views into the mapping, empty if there is no valid file)
+    void *mapping;
+    long size;
+    const unsigned long long *keys, *starts;
+    const unsigned int *order;
+    const int *data;
+    int entry_count;
+    //entry after the last one that was found, compilations of a similar source get the entries in the same order
+    int next;
+    //entries of the current compilation, written by store_analysis_cache
+    Analysis_Cache_Entry *entries;
+    int new_count, new_capacity;
+    int *new_data;
+    long new_size, new_data_capacity;
+} Analysis_Cache;
+
+//map the analysis cache of directory, the cache is empty if there is none (or it is invalid)
+Analysis_Cache *load_analysis_cache(char *directory);
+
+//entry with key from the cache file (its size is stored in size), NULL if there is none
+//the entry after the previously found one is tried first, so getting the entries in the order they were added is sequential
+const int *analysis_cache_get(Analysis_Cache *cache, unsigned long long key, int *size);
+
+//add an entry of size ints for the current compilation and return it to be filled by the caller
+//important: the returned pointer is only valid until the next call
+int *analysis_cache_add(Analysis_Cache *cache, unsigned long long key, int size);
+
+//keep an entry of the cache file (returned by analysis_cache_get) for the next compilation without copying it
+void analysis_cache_keep(Analysis_Cache *cache, unsigned long long key, const int *entry, int size);
+
+//forget the entries of the current compilation (kept and added ones), e.g. to analyze everything again
+void analysis_cache_reset(Analysis_Cache *cache);
+
+//replace the cache file of directory with the entries of the current compilation, return 1 if it could not be written
+int store_analysis_cache(char *directory, Analysis_Cache *cache);
+
+void free_analysis_cache(Analysis_Cache *cache);
+
+#endif
@@ -1,466 +1,383 @@
-#include <dirent.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdarg.h>
-#include <string.h>
-#include <sys/stat.h>
 #include "codegen.h"
-#include "parser.h"
+#include "compiler.h"
+#include "flat.h"
 #include "symbol.h"
+#include "output.h"
+#include "asm.h"
 
-#define INDENT_WIDTH 4
 #define REGISTER_SIZE 8 //64-bit ^= 8 byte
-#define FUNC_BUFFERS_PATH "out/func_buffers"
-
-//amount of bytes on the stack in addition to vars (e.g. return addrs) in bytes
-static int current_stack_addr_offset = 0;
-//every symbol that is represented by a label in the generated code gets this index appended to make it unique
-static int current_mangle_index = 0;
-
-//varargs style version of writef
-void vwritef(FILE *file, int indent_enabled, char *fmt, va_list fmt_args) {
-    //indent line if requested
-    if (indent_enabled) {
-        for (int i = 0; i < INDENT_WIDTH; i++) {
-            fprintf(file, " ");
-        }
+//code section of the main code, every function definition gets its own section after it
+#define MAIN_SECTION 0
+#define function_section(mangle_index) ((mangle_index) + 1)
+
+void write_header(Compiler_Context *context, Asm_Writer *out) {
+    if (out->text != NULL) {
+        output_literal(out->text,
+            "section .text\n"
+            "global _start\n\n"
+            "_start:\n");
     }
-    vfprintf(file, fmt, fmt_args);
-}
-
-//write indented output to file with variable amount of format parameters
-void writef(FILE *file, char *fmt, ...) {
-    va_list fmt_args;
-    va_start(fmt_args, fmt);
-    vwritef(file, 1, fmt, fmt_args);
-    va_end(fmt_args);
-}
-
-//like writef, but do not indent
-void writef_ni(FILE *file, char *fmt, ...) {
-    va_list fmt_args;
-    va_start(fmt_args, fmt);
-    vwritef(file, 0, fmt, fmt_args);
-    va_end(fmt_args);
-}
-
-//write indented output to file with newline and variable amount of format parameters
-void writelnf(FILE *file, char *fmt, ...) {
-    va_list fmt_args;
-    va_start(fmt_args, fmt);
-    vwritef(file, 1, fmt, fmt_args);
-    va_end(fmt_args);
-    fprintf(file, "\n");
+    if (context->run) {
+        //called by the host with the top of the program stack in rdi, the registers the host expects to be preserved are saved on its stack
+        asm_op1(out, ASM_PUSH, asm_register(REG_RBP));
+        asm_op1(out, ASM_PUSH, asm_register(REG_RBX));
+        asm_op2(out, ASM_MOV, asm_register(REG_RAX), asm_register(REG_RSP));
+        asm_op2(out, ASM_MOV, asm_register(REG_RSP), asm_register(REG_RDI));
+        //the stack pointer of the host is the first slot of the program stack, the stack slots of the program start below it
+        asm_op1(out, ASM_PUSH, asm_register(REG_RAX));
+    }
+    asm_op2(out, ASM_MOV, asm_register(REG_RBP), asm_register(REG_RSP));
+    asm_blank(out);
 }
 
-//like writelnf, but do not indent
-void writelnf_ni(FILE *file, char *fmt, ...) {
-    va_list fmt_args;
-    va_start(fmt_args, fmt);
-    vwritef(file, 0, fmt, fmt_args);
-    va_end(fmt_args);
-    fprintf(file, "\n");
+void write_exit(Compiler_Context *context, Asm_Writer *out) {
+    if (context->run) {
+        //return to the host instead of exiting the process
+        asm_op2(out, ASM_MOV, asm_register(REG_RSP), asm_stack(0));
+        asm_op1(out, ASM_POP, asm_register(REG_RBX));
+        asm_op1(out, ASM_POP, asm_register(REG_RBP));
+        asm_op0(out, ASM_RET);
+        return;
+    }
+    asm_op2(out, ASM_MOV, asm_register(REG_RAX), asm_immediate(60));
+    asm_op2(out, ASM_MOV, asm_register(REG_RDI), asm_immediate(0));
+    asm_op0(out, ASM_SYSCALL);
 }
 
-char *comb_str(char *first, char *second) {
-    int size = strlen(first) + strlen(second) + 1;
-    char *output = calloc(size, sizeof(char));
-    strcpy(output, first);
-    return strcat(output, second);
+void assign_addrs(Compiler_Context *context) {
+    Symbol_Table *table = context->table;
+    //the addresses only depend on the symbol table, so assigning them again gives the same result
+    context->mangle_index = 0;
+    //first address after the symbols of each scope, child scopes start their addresses there
+    //(siblings never live at the same time, so they share their addresses)
+    int *scope_end = malloc(table->scope_count * sizeof(int));
+    //scopes are stored in pre-order, so the parent of a scope is always done before the scope itself
+    for (int id = 0; id < table->scope_count; id++) {
+        Scope *scope = symbol_table_scope(table, id);
+        int addr_offset = scope->parent == NO_SCOPE ? 0 : scope_end[scope->parent];
+        //assign addr to each symbol
+        Collection_Container *current_sym_cont = scope->symbols->root;
+        while (current_sym_cont != NULL) {
+            Symbol *current_symbol = current_sym_cont->item;
+            //assign memory address to actual vars, but also
+            //assign two memory addresses to functions (to store stack pointer & return address at the beginning of the function)
+            if (current_symbol->type == SYM_FUNC) {
+                current_symbol->addr = addr_offset + 1;
+                addr_offset += 2;
+                //also set mangle index for function symbols while we're at it
+                current_symbol->mangle_index = context->mangle_index;
+                context->mangle_index += 1;
+            }
+            else {
+                current_symbol->addr = addr_offset;
+                addr_offset += 1;
+            }
+            current_sym_cont = current_sym_cont->next;
+        }
+        scope_end[id] = addr_offset;
+    }
+    free(scope_end);
 }
 
-void write_header(FILE *file) {
-    char header[] =
-        "section .text\n"
-        "global _start\n\n"
-        "_start:";
-    writelnf_ni(file, header);
-    writelnf(file, "mov rbp, rsp\n");
+//converts "virtual" symbol-table addr to stack addr, relative to rbp
+//(relative to rbp means the addr is n bytes lower than rbp)
+int stack_addr(Symbol *symbol) {
+    return (symbol->addr + 1) * REGISTER_SIZE;
 }
 
-void write_exit(FILE *file) {
-    writelnf(file, "mov rax, 60");
-    writelnf(file, "mov rdi, 0");
-    writelnf(file, "syscall");
+//value of a number literal token (only decimal digits)
+long token_number(Token_List *tokens, int token) {
+    const char *digits = token_value(tokens, token);
+    int length = tokens->lengths[token];
+    unsigned long value = 0;
+    for (int i = 0; i < length; i++) {
+        value = value * 10 + (digits[i] - '0');
+    }
+    return (long) value;
 }
 
-void _assign_addrs(Scope *scope, int addr_offset) {
-    //assign addr to each symbol
-    Collection_Container *current_sym_cont = scope->symbols->root;
-    while (current_sym_cont != NULL) {
-        Symbol *current_symbol = current_sym_cont->item;
-        //assign memory address to actual vars, but also
-        //assign two memory addresses to functions (to store stack pointer & return address at the beginning of the function)
-        if (current_symbol->type == SYM_FUNC) {
-            current_symbol->addr = addr_offset + 1;
-            addr_offset += 2;
-            //also set mangle index for function symbols while we're at it
-            current_symbol->mangle_index = current_mangle_index;
-            current_mangle_index += 1;
-        }
-        else {
-            current_symbol->addr = addr_offset;
-            addr_offset += 1;
-        }
-        current_sym_cont = current_sym_cont->next;
-    }
-    //repeat for every child scope, but start addresses at offset
-    Collection_Container *current_scope_cont = scope->scopes->root;
-    while (current_scope_cont != NULL) {
-        Scope *current_scope = current_scope_cont->item;
-        _assign_addrs(current_scope, addr_offset);
-        current_scope_cont = current_scope_cont->next;
+//operand of a variable (its stack slot) or a constant (immediate)
+Operand value_operand(Compiler_Context *context, int value) {
+    if (flat_kind(context->ast, value) == ND_VAR) {
+        return asm_stack(stack_addr(resolved_symbol(context->table, value)));
     }
+    return asm_immediate(token_number(context->tokens, context->ast->nodes[value].token));
 }
 
-void assign_addrs(Symbol_Table *table) {
-    _assign_addrs(table->root_scope, 0);
+Label function_label(Compiler_Context *context, int node, Symbol *symbol, Label_Kind kind) {
+    Token_List *tokens = context->tokens;
+    int name = context->ast->nodes[node].token;
+    return (Label) { kind, token_value(tokens, name), tokens->lengths[name], symbol->mangle_index };
 }
 
-//converts "virtual" symbol-table addr to stack addr, relative to rbp
-//(relative to rbp means the addr is n bytes lower than rbp)
-int stack_addr(Symbol *symbol) {
-    return (symbol->addr + 1) * REGISTER_SIZE;
+Label branch_label(Label_Kind kind, int index) {
+    return (Label) { kind, NULL, 0, index };
 }
 
-int write_statements(AST_Node *statements, Symbol_Table *table, FILE *out_file);
-
-int write_assign(AST_Node *assignment, Symbol_Table *table, FILE *out_file) {
-    AST_Node *assignee = assignment->lhs;
-    AST_Node *expr = assignment->rhs;
-    Symbol *assignee_sym = symbol_table_is_local(table, assignee->token);
-    int is_initial_assign = assignee_sym != NULL && !assignee_sym->initialized;
-    if (is_initial_assign) {
-        assignee_sym->initialized = 1;
-    }
-    int is_composite = expr->node_type == ND_ADD || expr->node_type == ND_SUB;
+int write_statements(Compiler_Context *context, int statement, int end, Asm_Writer *out);
+
+void write_assign(Compiler_Context *context, int assignment, Asm_Writer *out) {
+    Flat_AST *ast = context->ast;
+    Flat_Node *nodes = ast->nodes;
+    int assignee = flat_lhs(ast, assignment);
+    int expr = flat_rhs(ast, assignment);
+    //the initial assignment is the one that defined the symbol during semantic analysis
+    Symbol *assignee_sym = resolved_symbol(context->table, assignment);
+    int is_initial_assign = assignee_sym->name == nodes[assignee].token;
+    int is_composite = nodes[expr].kind == ND_ADD || nodes[expr].kind == ND_SUB;
+    //operands, only valid if the expression is composite (a leaf at the end of the AST has no following nodes)
+    int expr_lhs = is_composite ? flat_lhs(ast, expr) : NO_NODE;
+    int expr_rhs = is_composite ? flat_rhs(ast, expr) : NO_NODE;
+    Asm_Opcode operator = nodes[expr].kind == ND_ADD ? ASM_ADD : ASM_SUB;
+    Operand rax = asm_register(REG_RAX);
     if (is_initial_assign) {
+        //the stack slot of a new var is allocated by pushing its initial value
         if (is_composite) {
             //init = a +/- b
-            writef(out_file, "mov rax, ");
-            if (expr->lhs->node_type == ND_VAR) {
-                //init = var +/- ...
-                int addr = stack_addr(symbol_table_get(table, expr->lhs->token));
-                writelnf_ni(out_file, "[rbp - %d]", addr);
-            }
-            else {
-                //init = const +/- ...
-                char *constant = expr->lhs->token->value;
-                writelnf_ni(out_file, "%s", constant);
-            }
-            //write operator
-            if (expr->node_type == ND_ADD) {
-                writef(out_file, "add rax, ");
-            }
-            else {
-                writef(out_file, "sub rax, ");
-            }
-            if (expr->rhs->node_type == ND_VAR) {
-                //init = ... +/- var
-                int addr = stack_addr(symbol_table_get(table, expr->rhs->token));
-                writelnf_ni(out_file, "[rbp - %d]", addr);
-            }
-            else {
-                //init = ... +/- const
-                char *constant = expr->rhs->token->value;
-                writelnf_ni(out_file, "%s", constant);
-            }
-            writelnf(out_file, "push rax");
+            asm_op2(out, ASM_MOV, rax, value_operand(context, expr_lhs));
+            asm_op2(out, operator, rax, value_operand(context, expr_rhs));
+            asm_op1(out, ASM_PUSH, rax);
         }
         else {
             //init = var/const
-            writef(out_file, "push ");
-            if (expr->node_type == ND_VAR) {
-                //init = var
-                int addr = stack_addr(symbol_table_get(table, expr->token));
-                writelnf_ni(out_file, "[rbp - %d]", addr);
-            }
-            else {
-                //init = const
-                char *constant = expr->token->value;
-                writelnf_ni(out_file, "%s", constant);
-            }
+            asm_op1(out, ASM_PUSH, value_operand(context, expr));
         }
     }
     else {
-        int assignee_addr = stack_addr(symbol_table_get(table, assignee->token));
+        Operand assignee_slot = asm_stack(stack_addr(assignee_sym));
         if (is_composite) {
-            //exist = a +/- b
-            if (expr->lhs->node_type == ND_INT && expr->rhs->node_type == ND_INT) {
+            if (nodes[expr_lhs].kind == ND_INT && nodes[expr_rhs].kind == ND_INT) {
                 //exist = const +/- const
-                char *constant1 = expr->lhs->token->value;
-                writelnf(out_file, "mov [rbp - %d], %s", assignee_addr, constant1);
-                //write operator
-                if (expr->node_type == ND_ADD) {
-                    writef(out_file, "add ");
-                }
-                else {
-                    writef(out_file, "sub ");
-                }
-                char *constant2 = expr->rhs->token->value;
-                writelnf_ni(out_file, "[rbp - %d], %s", assignee_addr, constant2);
+                asm_op2(out, ASM_MOV, assignee_slot, value_operand(context, expr_lhs));
+                asm_op2(out, operator, assignee_slot, value_operand(context, expr_rhs));
             }
             else {
                 //exist = var +/- var | const +/- var | var +/- const
-                writef(out_file, "mov rax, ");
-                if (expr->lhs->node_type == ND_VAR) {
-                    //exist = var +/- ...
-                    int addr = stack_addr(symbol_table_get(table, expr->lhs->token));
-                    writelnf_ni(out_file, "[rbp - %d]", addr);
-                }
-                else {
-                    //exist = const +/- ...
-                    char *constant = expr->lhs->token->value;
-                    writelnf_ni(out_file, "%s", constant);
-                }
-                //write operator
-                if (expr->node_type == ND_ADD) {
-                    writef(out_file, "add ");
-                }
-                else {
-                    writef(out_file, "sub ");
-                }
-                writef_ni(out_file, "rax, ");
-                if (expr->rhs->node_type == ND_VAR) {
-                    //exist = ... +/- var
-                    int addr = stack_addr(symbol_table_get(table, expr->rhs->token));
-                    writelnf_ni(out_file, "[rbp - %d]", addr);
-                }
-                else {
-                    //exist = ... +/- const
-                    char *constant = expr->rhs->token->value;
-                    writelnf_ni(out_file, "%s", constant);
-                }
-                //store result
-                writelnf(out_file, "mov [rbp - %d], rax", assignee_addr);
+                asm_op2(out, ASM_MOV, rax, value_operand(context, expr_lhs));
+                asm_op2(out, operator, rax, value_operand(context, expr_rhs));
+                asm_op2(out, ASM_MOV, assignee_slot, rax);
             }
         }
+        else if (nodes[expr].kind == ND_VAR) {
+            //exist = var (no memory to memory mov)
+            asm_op2(out, ASM_MOV, rax, value_operand(context, expr));
+            asm_op2(out, ASM_MOV, assignee_slot, rax);
+        }
         else {
-            //exist = var/const
-            if (expr->node_type == ND_VAR) {
-                //exist = var
-                int addr = stack_addr(symbol_table_get(table, expr->token));
-                writelnf(out_file, "mov rax, [rbp - %d]", addr);
-                writelnf(out_file, "mov [rbp - %d], rax", assignee_addr);
-            }
-            else {
-                //exist = const
-                char *constant = expr->token->value;
-                writelnf(out_file, "mov qword [rbp - %d], %s", assignee_addr, constant);
-            }
+            //exist = const
+            asm_op2(out, ASM_MOV, assignee_slot, value_operand(context, expr));
         }
     }
-    writef(out_file, "\n");
-    return 0;
+    asm_blank(out);
 }
 
-int write_function_def(AST_Node *function_def, Symbol_Table *table) {
-    FILE *out_file = fopen(comb_str(comb_str(FUNC_BUFFERS_PATH, "/"), function_def->token->value), "w+");
-
-    writelnf_ni(out_file, "%s_%d:", function_def->token->value, symbol_table_get(table, function_def->token)->mangle_index);
-    current_stack_addr_offset += 1;
-    if (function_def->children == NULL) {
-        writelnf(out_file, "nop");
+//parent is the writer of the code that contains the definition
+int write_function_def(Compiler_Context *context, int function_def, Asm_Writer *parent) {
+    Flat_AST *ast = context->ast;
+    Symbol *symbol = resolved_symbol(context->table, function_def);
+    //nested definitions are written while this one is still open, so every definition gets its own buffers (and code section)
+    Output_Buffer *text = parent->text != NULL ? new_output_buffer(NO_FD) : NULL;
+    Output_Buffer *code = parent->code != NULL ? new_output_buffer(NO_FD) : NULL;
+    Asm_Writer *out = new_asm_writer(text, code, function_section(symbol->mangle_index), parent->links);
+    context->functions[symbol->mangle_index] = out;
+
+    asm_label(out, function_label(context, function_def, symbol, LABEL_FUNCTION));
+    context->stack_addr_offset += 1;
+    if (ast->nodes[function_def].payload == 0) {
+        asm_op0(out, ASM_NOP);
     }
     else {
-        writelnf(out_file, "push rsp");
-        writelnf(out_file, "%s_%d_inner:", function_def->token->value, symbol_table_get(table, function_def->token)->mangle_index);
-        int err = write_statements(function_def->children, table, out_file);
+        asm_op1(out, ASM_PUSH, asm_register(REG_RSP));
+        asm_label(out, function_label(context, function_def, symbol, LABEL_FUNCTION_INNER));
+        int err = write_statements(context, function_def + 1, flat_end(ast, function_def), out);
         if (err) return 1;
-        int addr = stack_addr(symbol_table_get(table, function_def->token));
-        writelnf(out_file, "mov rsp, [rbp - %d]", addr);
+        asm_op2(out, ASM_MOV, asm_register(REG_RSP), asm_stack(stack_addr(symbol)));
     }
-    writelnf(out_file, "ret\n");
-    current_stack_addr_offset -= 1;
-    fclose(out_file);
+    asm_op0(out, ASM_RET);
+    asm_blank(out);
+    context->stack_addr_offset -= 1;
     return 0;
 }
 
-void write_function_call(AST_Node *function_call, Symbol_Table *table, FILE *out_file) {
-    if (symbol_table_is_local(table, function_call->token)) {
-        writelnf(out_file, "call %s_%d\n", function_call->token->value, symbol_table_get(table, function_call->token)->mangle_index);
+void write_function_call(Compiler_Context *context, int function_call, Asm_Writer *out) {
+    Symbol *symbol = resolved_symbol(context->table, function_call);
+    if (resolved_is_local(context->table, function_call)) {
+        asm_jump(out, ASM_CALL, function_label(context, function_call, symbol, LABEL_FUNCTION));
     }
     else {
-        writelnf(out_file, "jmp %s_%d_inner\n", function_call->token->value, symbol_table_get(table, function_call->token)->mangle_index);
+        asm_jump(out, ASM_JMP, function_label(context, function_call, symbol, LABEL_FUNCTION_INNER));
     }
+    asm_blank(out);
 }
 
-void write_boolean(AST_Node *boolean, Symbol_Table *table, FILE *out_file) {
-    AST_Node *lhs = boolean->lhs;
-    AST_Node *rhs = boolean->rhs;
-    if (lhs->node_type == ND_INT && rhs->node_type == ND_INT) {
-        char *constant1 = lhs->token->value;
-        writelnf(out_file, "mov rax, %s", constant1);
-        char *constant2 = rhs->token->value;
-        writelnf(out_file, "mov rbx, %s", constant2);
-        writelnf(out_file, "cmp rax, rbx");
+void write_boolean(Compiler_Context *context, int boolean, Asm_Writer *out) {
+    Flat_AST *ast = context->ast;
+    int lhs_node = flat_lhs(ast, boolean);
+    int rhs_node = flat_rhs(ast, boolean);
+    AST_Node_Type lhs = ast->nodes[lhs_node].kind;
+    AST_Node_Type rhs = ast->nodes[rhs_node].kind;
+    Operand rax = asm_register(REG_RAX);
+    if (lhs == ND_INT && rhs == ND_INT) {
+        Operand rbx = asm_register(REG_RBX);
+        asm_op2(out, ASM_MOV, rax, value_operand(context, lhs_node));
+        asm_op2(out, ASM_MOV, rbx, value_operand(context, rhs_node));
+        asm_op2(out, ASM_CMP, rax, rbx);
     }
-    else if (lhs->node_type == ND_VAR && rhs->node_type == ND_INT) {
-        char *constant = rhs->token->value;
-        writelnf(out_file, "mov rax, %s", constant);
-        int addr = stack_addr(symbol_table_get(table, lhs->token));
-        writelnf(out_file, "cmp [rbp - %d], rax", addr);
+    else if (lhs == ND_VAR && rhs == ND_INT) {
+        asm_op2(out, ASM_MOV, rax, value_operand(context, rhs_node));
+        asm_op2(out, ASM_CMP, value_operand(context, lhs_node), rax);
     }
-    else if (lhs->node_type == ND_INT && rhs->node_type == ND_VAR) {
-        char *constant = lhs->token->value;
-        writelnf(out_file, "mov rax, %s", constant);
-        int addr = stack_addr(symbol_table_get(table, rhs->token));
-        writelnf(out_file, "cmp [rbp - %d], rax", addr);
+    else if (lhs == ND_INT && rhs == ND_VAR) {
+        asm_op2(out, ASM_MOV, rax, value_operand(context, lhs_node));
+        asm_op2(out, ASM_CMP, value_operand(context, rhs_node), rax);
     }
     else {
-        int addr1 = stack_addr(symbol_table_get(table, lhs->token));
-        int addr2 = stack_addr(symbol_table_get(table, rhs->token));
-        writelnf(out_file, "mov rax, [rbp - %d]", addr1);
-        writelnf(out_file, "cmp rax, [rbp - %d]", addr2);
+        asm_op2(out, ASM_MOV, rax, value_operand(context, lhs_node));
+        asm_op2(out, ASM_CMP, rax, value_operand(context, rhs_node));
     }
 }
 
-void write_condition(AST_Node *condition, Symbol_Table *table, FILE *out_file, int *scope_index) {
-    write_boolean(condition->ms, table, out_file);
-    if (condition->ms->token->type == TK_EQU) {
-        writef(out_file, "jne ");
-    }
-    else {
-        writef(out_file, "je ");
-    }
-    if (condition->rhs != NULL) {
+int write_condition(Compiler_Context *context, int condition, Asm_Writer *out) {
+    Flat_AST *ast = context->ast;
+    int boolean = flat_cond_bool(ast, condition);
+    int cond_true = flat_cond_true(ast, condition);
+    int cond_false = flat_cond_false(ast, condition);
+    //nested conditions take the following indices, so the labels of this one have to use the index from before
+    int index = context->mangle_index;
+    context->mangle_index += 1;
+    write_boolean(context, boolean, out);
+    //jump over the 'true-case' if the boolean is false
+    Asm_Opcode jump = token_type(context->tokens, ast->nodes[boolean].token) == TK_EQU ? ASM_JNE : ASM_JE;
+    if (cond_false != NO_NODE) {
         //'else case' exits
-        writelnf_ni(out_file, "else_%d", current_mangle_index);
+        asm_jump(out, jump, branch_label(LABEL_ELSE, index));
     }
     else {
-        writelnf_ni(out_file, "end_%d", current_mangle_index);
+        asm_jump(out, jump, branch_label(LABEL_END, index));
     }
-    writef(out_file, "\n");
-
-    //set correct scope
-    symbol_table_walk_child(table);
-    for (int i = 0; i < *scope_index; i++) {
-        symbol_table_walk_next(table);
-    }
-    *scope_index += 1;
+    asm_blank(out);
 
     //write statements of 'true-case'
-    write_statements(condition->lhs->children, table, out_file);
-
-    if (condition->rhs != NULL) {
-        writelnf(out_file, "jmp end_%d", current_mangle_index);
-
-        symbol_table_walk_next(table);
-        *scope_index += 1;
-
-        writef(out_file, "\n");
-        writelnf(out_file, "else_%d:\n", current_mangle_index);
+    int err = write_statements(context, cond_true + 1, flat_end(ast, cond_true), out);
+    if (err) return 1;
+
+    if (cond_false != NO_NODE) {
+        asm_jump(out, ASM_JMP, branch_label(LABEL_END, index));
+        asm_blank(out);
+        asm_label(out, branch_label(LABEL_ELSE, index));
+        asm_blank(out);
         //write statements of 'false-case'
-        write_statements(condition->rhs->children, table, out_file);
+        err = write_statements(context, cond_false + 1, flat_end(ast, cond_false), out);
+        if (err) return 1;
     }
-    writelnf(out_file, "end_%d:\n", current_mangle_index);
+    asm_label(out, branch_label(LABEL_END, index));
+    asm_blank(out);
 
-    symbol_table_pop(table);
-
-    current_mangle_index += 1;
+    return 0;
 }
 
-int write_statements(AST_Node *statements, Symbol_Table *table, FILE *out_file) {
-    //used to keep track of which symbol table child scope is needed when writing function defs or conditions
-    int scope_index = 0;
-    AST_Node *current_statement = statements;
-    while (current_statement != NULL) {
-        if (current_statement->node_type == ND_ASSIGN) {
-            int err = write_assign(current_statement, table, out_file);
-            if (err) return 1;
+//write the statements in [statement, end), end is the end of the parent subtree
+int write_statements(Compiler_Context *context, int statement, int end, Asm_Writer *out) {
+    Flat_AST *ast = context->ast;
+    while (statement < end) {
+        AST_Node_Type kind = flat_kind(ast, statement);
+        int err = 0;
+        if (kind == ND_ASSIGN) {
+            write_assign(context, statement, out);
         }
-        else if (current_statement->node_type == ND_FUNCTION_DEF) {
-            symbol_table_walk_child(table);
-            for (int i = 0; i < scope_index; i++) {
-                symbol_table_walk_next(table);
-            }
-            int err = write_function_def(current_statement, table);
-            if (err) return 1;
-            symbol_table_pop(table);
-            scope_index += 1;
+        else if (kind == ND_FUNCTION_DEF) {
+            err = write_function_def(context, statement, out);
         }
-        else if (current_statement->node_type == ND_FUNCTION_CALL) {
-            write_function_call(current_statement, table, out_file);
+        else if (kind == ND_FUNCTION_CALL) {
+            write_function_call(context, statement, out);
         }
-        else if (current_statement->node_type == ND_COND) {
-            //need to pass scope_index into the function, because the child scope needs to be set after the boolean is analyzed
-            //and the scope needs to change one additional time if the condition has an 'else case'
-            write_condition(current_statement, table, out_file, &scope_index);
+        else if (kind == ND_COND) {
+            err = write_condition(context, statement, out);
         }
         else {
             printf("ERROR: AST_Node is not a statement\n");
             return 1;
         }
-        current_statement = current_statement->next;
+        if (err) return 1;
+        statement = flat_end(ast, statement);
     }
 
     return 0;
 }
 
-//merge output of function definition buffer files back into 'main' output file
-int merge_func_buffers(FILE *out_file) {
-    DIR *dir = opendir(FUNC_BUFFERS_PATH);
-    struct dirent *dirent;
-    if (dir == NULL) {
-        printf("ERROR: could not list contents of temporary output directory\n");
-        return 1;
-    }
-    //list all files in func buffer dir
-    fprintf(out_file, "\n");
-    while ((dirent = readdir(dir)) != NULL) {
-        //check if actually a file
-        if (dirent->d_type == DT_REG) {
-            //merge into 'main' output file
-            char *func_buffer_file_path = comb_str(comb_str(FUNC_BUFFERS_PATH, "/"), dirent->d_name);
-            FILE *func_buffer_file = fopen(func_buffer_file_path, "r");
-            fseek(func_buffer_file, 0, SEEK_END);
-            int file_size = ftell(func_buffer_file);
-            if (file_size > 0) {
-                rewind(func_buffer_file);
-                char *function_buffer = calloc(file_size + 1, sizeof(char));
-                fread(function_buffer, file_size, sizeof(char), func_buffer_file);
-                fprintf(out_file, "%s", function_buffer);
-            }
-            fclose(func_buffer_file);
-            int err = remove(func_buffer_file_path);
-            if (err) {
-                printf("WARNING: could not remove temporary output file %s\n", func_buffer_file_path);
-            }
+//merge the text of function definitions back into the main text, in order of their mangle index
+void merge_func_buffers(Compiler_Context *context, Output_Buffer *text) {
+    output_char(text, '\n');
+    for (int i = 0; i < context->function_count; i++) {
+        Asm_Writer *function = context->functions[i];
+        if (function != NULL) {
+            output_bytes(text, function->text->data, function->text->size);
         }
     }
-    closedir(dir);
-    int err = remove(FUNC_BUFFERS_PATH);
-    if (err) {
-        printf("WARNING: could not remmove temporary output directory %s\n", FUNC_BUFFERS_PATH);
-    }
-    return 0;
 }
 
-int codegen(AST_Node *ast_root, Symbol_Table *table, FILE *out_file) {
-    write_header(out_file);
-    symbol_table_reset_current(table);
-    assign_addrs(table);
+//place the main code and the code of all function definitions (in order of their mangle index) into context->code
+int link_code(Compiler_Context *context, Asm_Writer *main) {
+    int section_count = function_section(context->function_count);
+    Output_Buffer **sections = calloc(section_count, sizeof(Output_Buffer *));
+    sections[MAIN_SECTION] = main->code;
+    for (int i = 0; i < context->function_count; i++) {
+        if (context->functions[i] != NULL) {
+            sections[function_section(i)] = context->functions[i]->code;
+        }
+    }
+    context->code = new_output_buffer(NO_FD);
+    int err = x86_link(main->links, sections, section_count, context->code);
+    free(sections);
+    return err;
+}
 
-    if (ast_root->node_type != ND_ROOT) {
+int codegen(Compiler_Context *context, FILE *out_file) {
+    Flat_AST *ast = context->ast;
+    if (ast->count == 0 || flat_kind(ast, 0) != ND_ROOT) {
         printf("INTERNAL ERROR: AST has no root node\n");
         return 1;
     }
 
-    struct stat st = { 0 };
-    if (stat(FUNC_BUFFERS_PATH, &st) == -1) {
-        if (mkdir(FUNC_BUFFERS_PATH, 0777) == -1) {
-            printf("ERROR: could not create temporary output directory\n");
-            return 1;
+    //files are written directly with write(), anything else (e.g. memory streams) gets the whole text at the end
+    Output_Buffer *text = NULL;
+    if (out_file != NULL) {
+        fflush(out_file);
+        int fd = fileno(out_file);
+        text = new_output_buffer(fd < 0 ? NO_FD : fd);
+    }
+    Output_Buffer *code = NULL;
+    if (context->executable_file != NULL || context->run) {
+        code = new_output_buffer(NO_FD);
+        context->links = new_code_links();
+    }
+    Asm_Writer *out = new_asm_writer(text, code, MAIN_SECTION, context->links);
+
+    write_header(context, out);
+    assign_addrs(context);
+    //function symbols are numbered first, so their mangle indices are [0, function_count)
+    context->function_count = context->mangle_index;
+    context->functions = calloc(context->function_count, sizeof(Asm_Writer *));
+
+    int err = write_statements(context, 1, ast->count, out);
+    if (!err) {
+        write_exit(context, out);
+        if (code != NULL) {
+            err = link_code(context, out);
+        }
+    }
+    if (!err && text != NULL) {
+        merge_func_buffers(context, text);
+        err = text->fd == NO_FD ? output_write_file(text, out_file) : output_flush(text);
+        if (err) {
+            printf("ERROR: could not write output file\n");
         }
     }
 
-    int err = write_statements(ast_root->children, table, out_file);
-    if (err) return err;
-
-    write_exit(out_file);
-
-    err = merge_func_buffers(out_file);
-    if (err) return err;
-
-    return 0;
+    if (text != NULL) free_output_buffer(text);
+    if (code != NULL) free_output_buffer(code);
+    free_asm_writer(out);
+    return err;
 }
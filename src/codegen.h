@@ -2,9 +2,20 @@
 #define CODEGEN_H
 
 #include <stdio.h>
-#include "parser.h"
-#include "symbol.h"
+#include "compiler.h"
 
-int codegen(AST_Node *ast_root, Symbol_Table *table, FILE *out_file);
+//write the assembly of the analyzed AST of context to out_file (NULL to skip)
+//and generate the linked machine code into context->code if context needs an executable or runs the program
+int codegen(Compiler_Context *context, FILE *out_file);
+
+//assign a slot addr to every symbol (siblings share them) and a mangle index to every function symbol
+//the function symbols get the indices [0, function_count), context->mangle_index is the function count afterwards
+void assign_addrs(Compiler_Context *context);
+
+//value of the number literal token
+long token_number(Token_List *tokens, int token);
+
+//offset of the stack slot of symbol below rbp (valid after codegen assigned the addresses)
+int stack_addr(Symbol *symbol);
 
 #endif
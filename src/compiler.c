@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "compiler.h"
+#include "pool.h"
+#include "parser.h"
+#include "analysis.h"
+#include "codegen.h"
+#include "bytegen.h"
+#include "executable.h"
+
+Compiler_Context *new_compiler_context() {
+    Compiler_Context *new = malloc(sizeof(Compiler_Context));
+    new->lex_threads = 1;
+    new->parse_threads = 1;
+    new->analysis_threads = 1;
+    new->arena_flags = ARENA_DEFAULT;
+    new->arena_stats = 0;
+    new->ast_cache_dir = NULL;
+    new->analysis_cache_dir = NULL;
+    new->analysis_stats = 0;
+    new->executable_file = NULL;
+    new->run = 0;
+    new->interpret = 0;
+    new->source = NULL;
+    new->tokens = NULL;
+    new->ast = NULL;
+    new->cache = NULL;
+    new->symbol_arena = NULL;
+    new->table = NULL;
+    new->reused_functions = 0;
+    new->analyzed_functions = 0;
+    new->stack_addr_offset = 0;
+    new->mangle_index = 0;
+    new->functions = NULL;
+    new->function_count = 0;
+    new->links = NULL;
+    new->code = NULL;
+    new->stack = NULL;
+    new->bytecode = NULL;
+    new->slots = NULL;
+    return new;
+}
+
+void free_compiler_context(Compiler_Context *context) {
+    if (context->cache != NULL) {
+        free_ast_cache(context->cache);
+    }
+    else {
+        if (context->tokens != NULL) free_token_list(context->tokens);
+        if (context->ast != NULL) free_flat_ast(context->ast);
+    }
+    if (context->symbol_arena != NULL) {
+        free_arena(context->symbol_arena);
+    }
+    for (int i = 0; i < context->function_count; i++) {
+        Asm_Writer *function = context->functions[i];
+        if (function == NULL) continue;
+        if (function->text != NULL) free_output_buffer(function->text);
+        if (function->code != NULL) free_output_buffer(function->code);
+        free_asm_writer(function);
+    }
+    free(context->functions);
+    if (context->links != NULL) {
+        free_code_links(context->links);
+    }
+    if (context->code != NULL) {
+        free_output_buffer(context->code);
+    }
+    if (context->stack != NULL) {
+        free_jit_stack(context->stack);
+    }
+    if (context->bytecode != NULL) {
+        free_bytecode(context->bytecode);
+    }
+    free(context->slots);
+    free(context);
+}
+
+//lex and parse the source of the context into its tokens and flat AST, return 1 after reporting an error
+static int front_end(Compiler_Context *context) {
+    int err;
+    context->tokens = new_token_list();
+    if (context->lex_threads > 1) {
+        Thread_Pool *pool = new_thread_pool(context->lex_threads);
+        err = tokenize_parallel(context->source, context->tokens, pool);
+        free_thread_pool(pool);
+    }
+    else {
+        err = tokenize(context->source, context->tokens);
+    }
+    if (err) {
+        printf("Error while running lexer\n");
+        return 1;
+    }
+
+    //one arena per compiler step
+    Arena *ast_arena = new_arena(ARENA_BLOCK_SIZE, context->arena_flags);
+    AST_Node *ast;
+    if (context->parse_threads > 1) {
+        Thread_Pool *pool = new_thread_pool(context->parse_threads);
+        ast = parse_parallel(context->tokens, ast_arena, pool);
+        free_thread_pool(pool);
+    }
+    else {
+        ast = parse(context->tokens, ast_arena);
+    }
+    if (ast == NULL) {
+        free_arena(ast_arena);
+        printf("Error while running parser\n");
+        return 1;
+    }
+    //later steps only work on the flat AST, the pointer based one is released right away
+    context->ast = flatten_ast(ast, context->tokens);
+    if (context->arena_stats) {
+        arena_print_stats(ast_arena, "ast arena");
+        printf("flat ast: %d nodes, %zu bytes\n", context->ast->count, context->ast->count * sizeof(Flat_Node));
+    }
+    free_arena(ast_arena);
+    return 0;
+}
+
+int compile(Compiler_Context *context, Source *source, FILE *out_file) {
+    context->source = source;
+
+    //TODO use unified/consistent error handling for each compiler step
+
+    if (context->ast_cache_dir != NULL) {
+        context->cache = load_ast_cache(context->ast_cache_dir, source);
+    }
+    if (context->cache != NULL) {
+        //unchanged input, skip lexing and parsing
+        context->tokens = context->cache->tokens;
+        context->ast = context->cache->ast;
+    }
+    else {
+        int err = front_end(context);
+        if (err) return 1;
+        if (context->ast_cache_dir != NULL && store_ast_cache(context->ast_cache_dir, source, context->tokens, context->ast)) {
+            printf("WARNING: could not write ast cache to %s\n", context->ast_cache_dir);
+        }
+    }
+
+    context->symbol_arena = new_arena(ARENA_BLOCK_SIZE, context->arena_flags);
+    context->table = new_symbol_table(context->tokens, context->symbol_arena);
+    int err;
+    if (context->analysis_cache_dir != NULL) {
+        //incremental analysis is serial, unchanged bodies are restored instead of being checked
+        Analysis_Cache *cache = load_analysis_cache(context->analysis_cache_dir);
+        err = semantic_analysis_incremental(context->ast, context->table, cache, &context->reused_functions, &context->analyzed_functions);
+        if (!err && store_analysis_cache(context->analysis_cache_dir, cache)) {
+            printf("WARNING: could not write analysis cache to %s\n", context->analysis_cache_dir);
+        }
+        free_analysis_cache(cache);
+        if (context->analysis_stats) {
+            printf("analysis cache: %d functions reused, %d functions analyzed\n", context->reused_functions, context->analyzed_functions);
+        }
+    }
+    else if (context->analysis_threads > 1) {
+        Thread_Pool *pool = new_thread_pool(context->analysis_threads);
+        err = semantic_analysis_parallel(context->ast, context->table, pool);
+        free_thread_pool(pool);
+    }
+    else {
+        err = semantic_analysis(context->ast, context->table);
+    }
+    if (err) {
+        printf("Error while running semantic analysis\n");
+        return 1;
+    }
+
+    //an interpreted program only needs codegen for the assembly, an executable or a native run
+    if (!context->interpret || out_file != NULL || context->executable_file != NULL || context->run) {
+        err = codegen(context, out_file);
+        if (err) {
+            printf("Error while running codegen\n");
+            return 1;
+        }
+    }
+
+    if (context->executable_file != NULL) {
+        err = write_executable(context->executable_file, context->code);
+        if (err) {
+            printf("Error while writing the executable\n");
+            return 1;
+        }
+    }
+
+    if (context->arena_stats) {
+        arena_print_stats(context->symbol_arena, "symbol arena");
+    }
+
+    if (context->run) {
+        context->stack = new_jit_stack(JIT_STACK_SIZE);
+        err = context->stack == NULL ? 1 : jit_run(context->code, context->stack);
+        if (err == 1) {
+            printf("ERROR: could not map the program for execution\n");
+        }
+        if (err) return 1;
+    }
+
+    if (context->interpret) {
+        err = bytegen(context);
+        if (err) {
+            printf("Error while generating bytecode\n");
+            return 1;
+        }
+        context->slots = new_bytecode_slots(context->bytecode);
+        err = bytecode_run(context->bytecode, context->slots);
+        if (err) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <stdio.h>
+#include "arena.h"
+#include "source.h"
+#include "lexer.h"
+#include "flat.h"
+#include "cache.h"
+#include "symbol.h"
+#include "output.h"
+#include "asm.h"
+#include "jit.h"
+#include "bytecode.h"
+
+//options and state of a single compilation
+//all mutable state of the compiler steps lives here (or in objects owned by the context),
+//so any amount of compilations can run at the same time in one process
+typedef struct {
+    //options, set before calling compile
+    int lex_threads, parse_threads, analysis_threads;
+    Arena_Flags arena_flags;
+    int arena_stats;
+    //directory of the AST cache, NULL to disable the cache
+    char *ast_cache_dir;
+    //directory of the analysis cache (results of semantic analysis per top-level function), NULL to disable the cache
+    char *analysis_cache_dir;
+    //print how many function bodies were reused from the analysis cache
+    int analysis_stats;
+    //write a static ELF64 executable of the program to this file (machine code is generated in process), NULL to skip
+    FILE *executable_file;
+    //run the program in process after compiling it (its machine code returns to the host instead of exiting)
+    int run;
+    //interpret the program as bytecode after compiling it, no machine code is generated unless it is needed for another output
+    int interpret;
+
+    //results of the compiler steps
+    Source *source;
+    Token_List *tokens;
+    Flat_AST *ast;
+    //set if tokens and ast are views into a cache file
+    Ast_Cache *cache;
+    Arena *symbol_arena;
+    Symbol_Table *table;
+    //top-level function bodies restored from the analysis cache and checked again
+    int reused_functions, analyzed_functions;
+
+    //codegen
+    //amount of stack slots in addition to vars (e.g. return addrs)
+    int stack_addr_offset;
+    //every symbol that is represented by a label in the generated code gets this index appended to make it unique
+    int mangle_index;
+    //text and code of every function definition, indexed by the mangle index of its symbol
+    //appended to the main code in that order at the end, so the output does not depend on the order of completion
+    Asm_Writer **functions;
+    int function_count;
+    //labels and jumps of the machine code (only if machine code is generated)
+    Code_Links *links;
+    //linked machine code of the whole program, starts with _start (only if machine code is generated)
+    Output_Buffer *code;
+    //stack the program ran on (only if it was run), holds the final values of its variables
+    Jit_Stack *stack;
+    //bytecode of the program and the slots it was interpreted on (only if it was interpreted)
+    //slots[symbol->addr] holds the final value of a variable
+    Bytecode *bytecode;
+    long *slots;
+} Compiler_Context;
+
+//context with default options (single threaded, no cache)
+Compiler_Context *new_compiler_context();
+
+//release everything the context owns (the source stays with the caller)
+void free_compiler_context(Compiler_Context *context);
+
+//run all compiler steps on source and write the generated assembly to out_file (NULL to skip)
+//and the executable to the executable_file of context (if set), then run or interpret the program if requested
+//return 1 (after reporting the error) if any step fails
+//important: use a new context for every compilation
+int compile(Compiler_Context *context, Source *source, FILE *out_file);
+
+#endif
@@ -0,0 +1,46 @@
+#include <elf.h>
+#include <string.h>
+#include "executable.h"
+
+//the headers are followed directly by the code, the whole file is a single segment
+#define HEADERS_SIZE (sizeof(Elf64_Ehdr) + sizeof(Elf64_Phdr))
+#define PAGE_SIZE 4096
+
+int write_executable(FILE *file, Output_Buffer *code) {
+    size_t file_size = HEADERS_SIZE + code->size;
+    Elf64_Ehdr header = {
+        .e_ident = { ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS64, ELFDATA2LSB, EV_CURRENT, ELFOSABI_SYSV },
+        .e_type = ET_EXEC,
+        .e_machine = EM_X86_64,
+        .e_version = EV_CURRENT,
+        .e_entry = EXECUTABLE_BASE + HEADERS_SIZE,
+        .e_phoff = sizeof(Elf64_Ehdr),
+        .e_shoff = 0,
+        .e_flags = 0,
+        .e_ehsize = sizeof(Elf64_Ehdr),
+        .e_phentsize = sizeof(Elf64_Phdr),
+        .e_phnum = 1,
+        .e_shentsize = 0,
+        .e_shnum = 0,
+        .e_shstrndx = SHN_UNDEF,
+    };
+    //the file is mapped from its start, so the code ends up right behind the headers
+    Elf64_Phdr segment = {
+        .p_type = PT_LOAD,
+        .p_flags = PF_R | PF_X,
+        .p_offset = 0,
+        .p_vaddr = EXECUTABLE_BASE,
+        .p_paddr = EXECUTABLE_BASE,
+        .p_filesz = file_size,
+        .p_memsz = file_size,
+        .p_align = PAGE_SIZE,
+    };
+
+    Output_Buffer *image = new_output_buffer(NO_FD);
+    output_bytes(image, (char *) &header, sizeof(header));
+    output_bytes(image, (char *) &segment, sizeof(segment));
+    output_bytes(image, code->data, code->size);
+    int err = output_write_file(image, file);
+    free_output_buffer(image);
+    return err;
+}
@@ -0,0 +1,15 @@
+#ifndef EXECUTABLE_H
+#define EXECUTABLE_H
+
+#include <stdio.h>
+#include "output.h"
+
+//virtual address the executable is loaded at (the default of ld)
+#define EXECUTABLE_BASE 0x400000
+
+//write a static ELF64 executable for linux x86-64 to file
+//code is linked machine code that starts with the entry point, the headers and the code are written with a single write()
+//return 1 on failure
+int write_executable(FILE *file, Output_Buffer *code);
+
+#endif
@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include "flat.h"
+
+#define FLAT_AST_MIN_CAPACITY 64
+
+Flat_AST *new_flat_ast(int capacity) {
+    if (capacity < FLAT_AST_MIN_CAPACITY) {
+        capacity = FLAT_AST_MIN_CAPACITY;
+    }
+    Flat_AST *ast = malloc(sizeof(Flat_AST));
+    ast->nodes = malloc(capacity * sizeof(Flat_Node));
+    ast->count = 0;
+    ast->capacity = capacity;
+    return ast;
+}
+
+void free_flat_ast(Flat_AST *ast) {
+    free(ast->nodes);
+    free(ast);
+}
+
+//append a node, its size is set once its subtree is complete
+static int add_node(Flat_AST *ast, AST_Node_Type kind, int token, int payload) {
+    if (ast->count == ast->capacity) {
+        ast->capacity *= 2;
+        ast->nodes = realloc(ast->nodes, ast->capacity * sizeof(Flat_Node));
+    }
+    int node = ast->count;
+    ast->nodes[node] = (Flat_Node) { kind, 0, 1, token, payload };
+    ast->count += 1;
+    return node;
+}
+
+static int count_nodes(AST_Node *node);
+
+static int count_node_list(AST_Node *node) {
+    int count = 0;
+    while (node != NULL) {
+        count += count_nodes(node);
+        node = node->next;
+    }
+    return count;
+}
+
+static int count_nodes(AST_Node *node) {
+    int count = 1;
+    if (node->ms != NULL) count += count_nodes(node->ms);
+    if (node->lhs != NULL) count += count_nodes(node->lhs);
+    if (node->rhs != NULL) count += count_nodes(node->rhs);
+    return count + count_node_list(node->children);
+}
+
+static void flatten_node(Flat_AST *ast, AST_Node *node, Token_List *tokens);
+
+static int flatten_list(Flat_AST *ast, AST_Node *node, Token_List *tokens) {
+    int count = 0;
+    while (node != NULL) {
+        flatten_node(ast, node, tokens);
+        count += 1;
+        node = node->next;
+    }
+    return count;
+}
+
+static void flatten_node(Flat_AST *ast, AST_Node *node, Token_List *tokens) {
+    int payload = 0;
+    if (node->node_type == ND_VAR || node->node_type == ND_FUNCTION_CALL) {
+        payload = token_id(tokens, node->token);
+    }
+    int index = add_node(ast, node->node_type, node->token, payload);
+    switch (node->node_type) {
+        case ND_ROOT:
+        case ND_FUNCTION_DEF:
+        case ND_COND_TRUE:
+        case ND_COND_FALSE: {
+            int child_count = flatten_list(ast, node->children, tokens);
+            ast->nodes[index].payload = child_count;
+            break;
+        }
+        case ND_COND:
+            flatten_node(ast, node->ms, tokens);
+            flatten_node(ast, node->lhs, tokens);
+            if (node->rhs != NULL) {
+                flatten_node(ast, node->rhs, tokens);
+                ast->nodes[index].flags |= FLAT_HAS_ELSE;
+            }
+            break;
+        case ND_ASSIGN:
+        case ND_ADD:
+        case ND_SUB:
+        case ND_BOOLEAN:
+            flatten_node(ast, node->lhs, tokens);
+            flatten_node(ast, node->rhs, tokens);
+            break;
+        default:
+            //leaves
+            break;
+    }
+    ast->nodes[index].size = ast->count - index;
+}
+
+Flat_AST *flatten_ast(AST_Node *root, Token_List *tokens) {
+    Flat_AST *ast = new_flat_ast(count_nodes(root));
+    flatten_node(ast, root, tokens);
+    return ast;
+}
@@ -0,0 +1,63 @@
+#ifndef FLAT_H
+#define FLAT_H
+
+#include "parser.h"
+
+//compact AST made of a single contiguous array of nodes in pre-order
+//every node is directly followed by its subtree, so the first child of node i is i + 1
+//and the next sibling is i + size (no pointers, 32-bit indices only)
+//child order per kind:
+//ND_ROOT, ND_FUNCTION_DEF, ND_COND_TRUE, ND_COND_FALSE: statements
+//ND_ASSIGN: variable, expression
+//ND_ADD, ND_SUB, ND_BOOLEAN: lhs, rhs
+//ND_COND: boolean, ND_COND_TRUE, ND_COND_FALSE (only if FLAT_HAS_ELSE is set)
+
+//no node, e.g. the missing else case of a condition
+#define NO_NODE -1
+
+typedef enum {
+    //ND_COND: the condition has an else case
+    FLAT_HAS_ELSE = 1,
+} Flat_Node_Flags;
+
+typedef struct {
+    unsigned char kind; //AST_Node_Type
+    unsigned char flags;
+    //amount of nodes in the subtree, including the node itself
+    int size;
+    //index into the token list, NO_TOKEN if the node has no token
+    int token;
+    //kind specific payload
+    //ND_ROOT, ND_FUNCTION_DEF, ND_COND_TRUE, ND_COND_FALSE: amount of statements
+    //ND_VAR, ND_FUNCTION_CALL: interned id of the name
+    //all other kinds: 0
+    int payload;
+} Flat_Node;
+
+typedef struct {
+    Flat_Node *nodes;
+    int count, capacity;
+} Flat_AST;
+
+Flat_AST *new_flat_ast(int capacity);
+
+void free_flat_ast(Flat_AST *ast);
+
+//convert a pointer based AST into its flat representation (the AST itself is not modified)
+Flat_AST *flatten_ast(AST_Node *root, Token_List *tokens);
+
+#define flat_kind(ast, node) ((AST_Node_Type) (ast)->nodes[node].kind)
+
+//index of the node after the subtree of node (its next sibling, if the parent has more children)
+#define flat_end(ast, node) ((node) + (ast)->nodes[node].size)
+
+//children of binary and tertiary nodes
+#define flat_lhs(ast, node) ((node) + 1)
+#define flat_rhs(ast, node) flat_end(ast, flat_lhs(ast, node))
+
+//ND_COND parts
+#define flat_cond_bool(ast, node) ((node) + 1)
+#define flat_cond_true(ast, node) flat_end(ast, flat_cond_bool(ast, node))
+#define flat_cond_false(ast, node) ((ast)->nodes[node].flags & FLAT_HAS_ELSE ? flat_end(ast, flat_cond_true(ast, node)) : NO_NODE)
+
+#endif
@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+
+#define INTERN_TABLE_MIN_SLOTS 1024
+#define EMPTY_SLOT -1
+
+//mask of the lowest n bytes of a word, index 0 is never used
+static const unsigned long long low_bytes[9] = {
+    0, 0xff, 0xffff, 0xffffff, 0xffffffff, 0xffffffffff, 0xffffffffffff, 0xffffffffffffff, 0xffffffffffffffff,
+};
+
+static unsigned hash_view(const char *text, int length, long available) {
+    unsigned long long hash = length;
+    int i = 0;
+    if (length + 8 <= available) {
+        //word at a time, the bytes past the identifier are masked off (reading them is safe, they are part of the text)
+        for (; i < length; i += 8) {
+            unsigned long long word;
+            memcpy(&word, text + i, 8);
+            int remaining = length - i;
+            if (remaining < 8) {
+                word &= low_bytes[remaining];
+            }
+            hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+            hash ^= hash >> 29;
+        }
+        return (unsigned) (hash ^ (hash >> 32));
+    }
+    //close to the end of the text, assemble the words byte by byte
+    while (i < length) {
+        unsigned long long word = 0;
+        for (int j = 0; j < 8 && i + j < length; j++) {
+            word |= (unsigned long long) (unsigned char) text[i + j] << (j * 8);
+        }
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 29;
+        i += 8;
+    }
+    return (unsigned) (hash ^ (hash >> 32));
+}
+
+static Intern_Slot *new_slots(int slot_count) {
+    Intern_Slot *slots = malloc(slot_count * sizeof(Intern_Slot));
+    for (int i = 0; i < slot_count; i++) {
+        slots[i].id = EMPTY_SLOT;
+    }
+    return slots;
+}
+
+Intern_Table *new_intern_table(const char *text, long size) {
+    Intern_Table *table = malloc(sizeof(Intern_Table));
+    table->text = text;
+    table->size = size;
+    table->slot_count = INTERN_TABLE_MIN_SLOTS;
+    table->slots = new_slots(table->slot_count);
+    table->count = 0;
+    table->capacity = INTERN_TABLE_MIN_SLOTS / 2;
+    table->offsets = malloc(table->capacity * sizeof(long));
+    table->lengths = malloc(table->capacity * sizeof(int));
+    return table;
+}
+
+void free_intern_table(Intern_Table *table) {
+    free(table->slots);
+    free(table->offsets);
+    free(table->lengths);
+    free(table);
+}
+
+//double the amount of slots and reinsert all ids
+static void grow(Intern_Table *table) {
+    int slot_count = table->slot_count * 2;
+    Intern_Slot *slots = new_slots(slot_count);
+    for (int i = 0; i < table->slot_count; i++) {
+        if (table->slots[i].id == EMPTY_SLOT) {
+            continue;
+        }
+        unsigned slot = table->slots[i].hash & (slot_count - 1);
+        while (slots[slot].id != EMPTY_SLOT) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = table->slots[i];
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->slot_count = slot_count;
+
+    //keep the load factor at or below 1/2
+    table->capacity = slot_count / 2;
+    table->offsets = realloc(table->offsets, table->capacity * sizeof(long));
+    table->lengths = realloc(table->lengths, table->capacity * sizeof(int));
+}
+
+int intern(Intern_Table *table, long offset, int length) {
+    const char *name = table->text + offset;
+    unsigned hash = hash_view(name, length, table->size - offset);
+    unsigned slot = hash & (table->slot_count - 1);
+    while (table->slots[slot].id != EMPTY_SLOT) {
+        int id = table->slots[slot].id;
+        if (table->slots[slot].hash == hash && table->lengths[id] == length && memcmp(table->text + table->offsets[id], name, length) == 0) {
+            return id;
+        }
+        slot = (slot + 1) & (table->slot_count - 1);
+    }
+
+    //new identifier
+    if (table->count == table->capacity) {
+        grow(table);
+        slot = hash & (table->slot_count - 1);
+        while (table->slots[slot].id != EMPTY_SLOT) {
+            slot = (slot + 1) & (table->slot_count - 1);
+        }
+    }
+    int id = table->count;
+    table->offsets[id] = offset;
+    table->lengths[id] = length;
+    table->slots[slot] = (Intern_Slot) { hash, id };
+    table->count += 1;
+    return id;
+}
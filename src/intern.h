@@ -0,0 +1,36 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+//id of tokens that are not identifiers
+#define NO_IDENT -1
+
+typedef struct {
+    unsigned hash;
+    int id;
+} Intern_Slot;
+
+//string table of all distinct identifiers of a compilation
+//every identifier is interned once and gets a dense id (0, 1, 2, ...) in order of its first occurence,
+//so later compiler steps can compare names as integers and index side tables by id
+typedef struct {
+    //text that all identifiers are views into
+    const char *text;
+    long size;
+    //open addressing hash set of ids, slot_count is a power of two
+    //slots also store the hash, so most mismatches are found without touching the id arrays
+    Intern_Slot *slots;
+    int slot_count;
+    //view of the first occurence of every id
+    long *offsets;
+    int *lengths;
+    int count, capacity;
+} Intern_Table;
+
+Intern_Table *new_intern_table(const char *text, long size);
+
+void free_intern_table(Intern_Table *table);
+
+//return the id of text[offset, offset + length), a new id is assigned if the identifier has not been seen yet
+int intern(Intern_Table *table, long offset, int length);
+
+#endif
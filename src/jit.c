@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <sys/mman.h>
+#include "jit.h"
+
+//signals of a crashing program, they return to the host instead of killing the process
+static const int crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE };
+#define CRASH_SIGNAL_COUNT (int) (sizeof(crash_signals) / sizeof(int))
+//the stack pointer of a crashed program can be anything, so the handler runs on a stack of its own
+#define SIGNAL_STACK_SIZE (64 * 1024)
+
+//where a crash of the program that currently runs returns to
+static sigjmp_buf crash_return;
+
+//entry point of the generated code, top is the first address above the stack of the program
+typedef void Jit_Entry(char *top);
+
+//the program saves the stack pointer of the host in the top slot and uses the slot below as its rbp
+#define SAVED_HOST_SLOTS 1
+
+static size_t page_align(size_t size) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    return (size + page_size - 1) / page_size * page_size;
+}
+
+Jit_Stack *new_jit_stack(size_t size) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size = page_align(size);
+    char *guard = mmap(NULL, size + page_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (guard == MAP_FAILED) {
+        return NULL;
+    }
+    //the stack grows down, so an overflow runs into the guard page
+    if (mprotect(guard + page_size, size, PROT_READ | PROT_WRITE)) {
+        munmap(guard, size + page_size);
+        return NULL;
+    }
+    Jit_Stack *new = malloc(sizeof(Jit_Stack));
+    new->memory = guard + page_size;
+    new->size = size;
+    return new;
+}
+
+void free_jit_stack(Jit_Stack *stack) {
+    munmap(stack->memory - sysconf(_SC_PAGESIZE), stack->size + sysconf(_SC_PAGESIZE));
+    free(stack);
+}
+
+long jit_stack_slot(Jit_Stack *stack, int offset) {
+    char *rbp = stack->memory + stack->size - SAVED_HOST_SLOTS * sizeof(long);
+    long value;
+    memcpy(&value, rbp - offset, sizeof(long));
+    return value;
+}
+
+static void on_crash(int signal) {
+    siglongjmp(crash_return, signal);
+}
+
+int jit_run(Output_Buffer *code, Jit_Stack *stack) {
+    //writable while the code is copied, executable (and no longer writable) while it runs
+    size_t size = page_align(code->size);
+    char *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return 1;
+    }
+    memcpy(memory, code->data, code->size);
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC)) {
+        munmap(memory, size);
+        return 1;
+    }
+
+    stack_t signal_stack = { .ss_sp = malloc(SIGNAL_STACK_SIZE), .ss_size = SIGNAL_STACK_SIZE, .ss_flags = 0 };
+    stack_t previous_stack;
+    sigaltstack(&signal_stack, &previous_stack);
+    struct sigaction crash_action = { .sa_handler = on_crash, .sa_flags = SA_ONSTACK };
+    sigemptyset(&crash_action.sa_mask);
+    struct sigaction previous_actions[CRASH_SIGNAL_COUNT];
+    for (int i = 0; i < CRASH_SIGNAL_COUNT; i++) {
+        sigaction(crash_signals[i], &crash_action, &previous_actions[i]);
+    }
+
+    //a crash jumps back here with the signal (and restores the signal mask)
+    int signal = sigsetjmp(crash_return, 1);
+    if (signal == 0) {
+        Jit_Entry *entry = (Jit_Entry *) memory;
+        entry(stack->memory + stack->size);
+    }
+    else {
+        printf("ERROR: program crashed (%s)\n", strsignal(signal));
+    }
+
+    for (int i = 0; i < CRASH_SIGNAL_COUNT; i++) {
+        sigaction(crash_signals[i], &previous_actions[i], NULL);
+    }
+    sigaltstack(&previous_stack, NULL);
+    free(signal_stack.ss_sp);
+    munmap(memory, size);
+    return signal == 0 ? 0 : 2;
+}
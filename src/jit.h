@@ -0,0 +1,31 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stddef.h>
+#include "output.h"
+
+//in process execution of linked machine code (generated with a return to the host instead of the exit syscall)
+//the program runs on a stack of its own, its root variables stay readable there after it returned
+
+//size of the stack of a program (same as the default stack limit of a process)
+#define JIT_STACK_SIZE (8 * 1024 * 1024)
+
+typedef struct {
+    char *memory;
+    size_t size;
+} Jit_Stack;
+
+//stack of size bytes (rounded up to whole pages), with a guard page below it
+Jit_Stack *new_jit_stack(size_t size);
+
+void free_jit_stack(Jit_Stack *stack);
+
+//value of the stack slot [rbp - offset] of the program that ran on stack
+long jit_stack_slot(Jit_Stack *stack, int offset);
+
+//copy code into a new mapping, make it executable and call it on stack
+//return 1 if the code could not be mapped, 2 (after reporting the signal) if the program crashed
+//important: not thread safe, the signal handlers of the process are replaced while the program runs
+int jit_run(Output_Buffer *code, Jit_Stack *stack);
+
+#endif
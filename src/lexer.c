@@ -2,350 +2,464 @@
 #include <stdlib.h>
 #include <string.h>
 #include "lexer.h"
+#include "scan.h"
 
 #define strl(str) str, sizeof(str) - 1
 #define strsize(str) sizeof(str) - 1
 
-#define BACKLOG_MAX_SIZE 5
+#define TOKEN_LIST_MIN_CAPACITY 64
+//rough upper estimate of the average amount of source bytes per token, used to size the token list up front
+#define BYTES_PER_TOKEN 4
+//tokens are indexed by int, cap the up front reservation for huge inputs (the list still grows past it if needed)
+#define TOKEN_LIST_MAX_RESERVE (1 << 28)
+//minimum amount of source bytes per chunk when lexing in parallel
+#define PARALLEL_MIN_CHUNK_SIZE (256 * 1024)
 
-Token *new_token(Token_Type type, char *value, int value_size) {
-    Token *token = malloc(sizeof(Token));
-    token->type = type;
-    token->value = value;
-    token->value_size = value_size;
-    return token;
+const char *token_value(Token_List *list, int token) {
+    return list->source->text + list->offsets[token];
 }
 
-void free_token(Token *token) {
-    if (token->type == TK_IDENT || token->type == TK_NUM_LITERAL) {
-        free(token->value);
+Token_Type token_type(Token_List *list, int token) {
+    if (token < 0 || token >= list->count) {
+        return TK_EOF;
     }
-    free(token);
+    return list->types[token];
 }
 
-int token_equals(Token *first, Token *second) {
-    if (first == second) {
-        return 1;
-    }
-    if (first->value_size != second->value_size) {
-        return 0;
-    }
-    return strncmp(first->value, second->value, first->value_size) == 0;
+int token_id(Token_List *list, int token) {
+    return list->ids[token];
 }
 
-int error(char *msg, char *text, int pos) {
-    int line = 1;
-    int line_pos = 1;
-    for (int i = 0; i <= pos; i++) {
-        line_pos += 1;
-        if (text[i] == '\n') {
-            line += 1;
-            line_pos = 1;
-        }
-    }
-    printf("ERROR:%d:%d: %s\n", line, line_pos, msg);
-    return 1;
+int token_equals(Token_List *list, int first, int second) {
+    return list->ids[first] == list->ids[second];
 }
 
-int cmp(char *first, char *second, int size) {
-    return strncmp(first, second, size) == 0;
-}
-
-char *skip_past(char *text, char *pattern) {
-    text = strstr(text, pattern);
-    if (text != NULL) text += 1;
-    return text;
-}
-
-int is_alphabetical(char c) {
-    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
-}
-
-int is_numerical(char c) {
-    return c >= '0' && c <= '9';
-}
-
-int read_num_literal(char *text, int size) {
-    int lit_size = 0;
-    while (lit_size < size && is_numerical(text[lit_size])) {
-        lit_size += 1;
-    }
-    return lit_size;
-}
-
-int read_identifier(char *text, int size) {
-    int ident_size = 0;
-    if (ident_size < size && is_alphabetical(text[ident_size])) {
-        ident_size += 1;
+//character classes, every byte of the input is mapped to one of them
+//the scanner dispatches on the class of the first byte of a token
+typedef enum {
+    CC_INVALID, CC_NULL, CC_WHITESPACE, CC_ALPHABETICAL, CC_NUMERICAL, CC_SINGLE, CC_EQUALS, CC_EXCLAMATION, CC_SLASH,
+} Char_Class;
+
+static const unsigned char char_classes[256] = {
+    ['\0'] = CC_NULL,
+    [' '] = CC_WHITESPACE, ['\n'] = CC_WHITESPACE,
+    ['A' ... 'Z'] = CC_ALPHABETICAL, ['a' ... 'z'] = CC_ALPHABETICAL,
+    ['0' ... '9'] = CC_NUMERICAL,
+    ['{'] = CC_SINGLE, ['}'] = CC_SINGLE, ['('] = CC_SINGLE, [')'] = CC_SINGLE, ['+'] = CC_SINGLE, ['-'] = CC_SINGLE,
+    ['='] = CC_EQUALS,
+    ['!'] = CC_EXCLAMATION,
+    ['/'] = CC_SLASH,
+};
+
+//token types of characters in CC_SINGLE
+static const Token_Type single_char_tokens[256] = {
+    ['{'] = TK_OPEN_BRACE, ['}'] = TK_CLOSE_BRACE, ['('] = TK_OPEN_PAREN, [')'] = TK_CLOSE_PAREN, ['+'] = TK_ADD, ['-'] = TK_SUB,
+};
+
+//characters that can continue an identifier (alphabetical or numerical)
+static const unsigned char identifier_chars[256] = {
+    ['A' ... 'Z'] = 1, ['a' ... 'z'] = 1, ['0' ... '9'] = 1,
+};
+
+typedef struct {
+    char *name;
+    int size;
+    Token_Type type;
+} Keyword;
+
+#define KEYWORD_TABLE_SIZE 8
+
+//perfect hash over all keywords: no two keywords share a slot
+//(function: 8 ^ 'f' -> 6, if: 2 ^ 'i' -> 3, else: 4 ^ 'e' -> 1)
+#define keyword_hash(text, size) (((size) ^ (text)[0]) & (KEYWORD_TABLE_SIZE - 1))
+
+static const Keyword keywords[KEYWORD_TABLE_SIZE] = {
+    [6] = { strl("function"), TK_FUNC_KW },
+    [3] = { strl("if"), TK_IF_KW },
+    [1] = { strl("else"), TK_ELSE_KW },
+};
+
+//return the keyword type of an identifier or TK_IDENT if it is not a keyword
+static inline Token_Type keyword_type(const char *text, int size) {
+    const Keyword *keyword = &keywords[keyword_hash(text, size)];
+    if (keyword->size != size) {
+        return TK_IDENT;
     }
-    while (ident_size < size && (is_alphabetical(text[ident_size]) || is_numerical(text[ident_size]))) {
-        ident_size += 1;
+    for (int i = 0; i < size; i++) {
+        if (keyword->name[i] != text[i]) {
+            return TK_IDENT;
+        }
     }
-    return ident_size;
-}
-
-//Token List Node
-
-Token_List_Node *new_token_list_node(Token *token) {
-    Token_List_Node *new = malloc(sizeof(Token_List_Node));
-    new->next = NULL;
-    new->previous = NULL;
-    new->token = token;
-    return new;
-}
-
-void free_token_list_node(Token_List_Node *node) {
-    free(node);
+    return keyword->type;
 }
 
 //Token List
 
 Token_List *new_token_list() {
     Token_List *new = malloc(sizeof(Token_List));
-    new->root = NULL;
-    new->current = NULL;
-    new->last = NULL;
+    new->types = NULL;
+    new->offsets = NULL;
+    new->lengths = NULL;
+    new->ids = NULL;
+    new->count = 0;
+    new->capacity = 0;
+    new->current = 0;
+    new->source = NULL;
+    new->identifiers = NULL;
     return new;
 }
 
 void free_token_list(Token_List *list) {
-    Token_List_Node *node = list->root;
-    while (node != NULL) {
-        Token_List_Node *next = node->next;
-        free_token(node->token);
-        free_token_list_node(node);
-        node = next;
+    free(list->types);
+    free(list->offsets);
+    free(list->lengths);
+    free(list->ids);
+    if (list->identifiers != NULL) {
+        free_intern_table(list->identifiers);
     }
     free(list);
 }
 
-void token_list_add(Token_List *list, Token *new) {
-    Token_List_Node *new_node = new_token_list_node(new);
-    if (list->root == NULL) {
-        list->root = new_node;
-        list->current = new_node;
-        list->last = new_node;
+void token_list_reserve(Token_List *list, int capacity) {
+    if (capacity <= list->capacity) {
+        return;
     }
-    else {
-        if (list->last != NULL) {
-            new_node->previous = list->last;
-            list->last->next = new_node;
-            list->last = new_node;
-        }
+    list->types = realloc(list->types, capacity * sizeof(Token_Type));
+    list->offsets = realloc(list->offsets, capacity * sizeof(long));
+    list->lengths = realloc(list->lengths, capacity * sizeof(int));
+    list->ids = realloc(list->ids, capacity * sizeof(int));
+    list->capacity = capacity;
+}
+
+int token_list_add(Token_List *list, Token_Type type, long offset, int length) {
+    if (list->count == list->capacity) {
+        token_list_reserve(list, list->capacity < TOKEN_LIST_MIN_CAPACITY ? TOKEN_LIST_MIN_CAPACITY : list->capacity * 2);
     }
+    int token = list->count;
+    list->types[token] = type;
+    list->offsets[token] = offset;
+    list->lengths[token] = length;
+    list->ids[token] = type == TK_IDENT && list->identifiers != NULL ? intern(list->identifiers, offset, length) : NO_IDENT;
+    list->count += 1;
+    return token;
 }
 
-Token *token_list_current(Token_List *list) {
-    if (list->current == NULL) {
-        return NULL;
+int token_list_current(Token_List *list) {
+    if (list->current >= list->count) {
+        return NO_TOKEN;
     }
-    return list->current->token;
+    return list->current;
+}
+
+Token_Type token_list_current_type(Token_List *list) {
+    return token_type(list, list->current);
 }
 
 //return current and forward
-Token *token_list_next(Token_List *list) {
-    if (list->root == NULL || list->current == NULL) {
-        return NULL;
-    }
-    Token *token = list->current->token;
-    list->current = list->current->next;
+int token_list_next(Token_List *list) {
+    int token = token_list_current(list);
+    token_list_forward(list);
     return token;
 }
 
 //just forward
 void token_list_forward(Token_List *list) {
-    if (list->root != NULL && list->current != NULL) {
-        list->current = list->current->next;
+    if (list->current < list->count) {
+        list->current += 1;
     }
 }
 
+Token_Type token_list_lookahead_type(Token_List *list) {
+    return token_type(list, list->current + 1);
+}
+
 void token_list_rewind(Token_List *list, int distance) {
-    if (list->root != NULL && list->last != NULL) {
-        while (distance > 0) {
-            if (list->current == list->root || list->current->previous == NULL) {
-                return;
-            }
-            if (list->current == NULL) {
-                list->current = list->last;
-            }
-            else {
-                list->current = list->current->previous;
-            }
-            distance -= 1;
-        }
+    list->current -= distance;
+    if (list->current < 0) {
+        list->current = 0;
     }
 }
 
-int tokenize(char *text, int size, Token_List *tokens) {
-    char *text_start = text;
-    int i = 0;
-    while (i < size) {
-
-        //skip line comments
-        if (cmp(text, strl("//"))) {
-            char *before_skip = text;
-            text = skip_past(text, "\n");
-            if (text == NULL) break;
-            i += text - before_skip;
-            continue;
-        }
-
-        //skip block comments
-        if (cmp(text, strl("/*"))) {
-            char *before_skip = text;
-            text = skip_past(text, "*/");
-            if (text == NULL) return error("unclosed block comment", text_start, i);
-            i += text - before_skip;
-            continue;
-        }
-
-        //skip newline
-        if (cmp(text, strl("\n"))) {
-            text += 1;
-            i += 1;
-            continue;
-        }
-
-        //skip whitespace
-        if (cmp(text, strl(" "))) {
-            text += 1;
-            i += 1;
-            continue;
-        }
-
-        //function keyword
-        if (cmp(text, strl("function"))) {
-            text += strsize("function");
-            i += strsize("function");
-            Token *new = new_token(TK_FUNC_KW, strl("function"));
-            token_list_add(tokens, new);
-            continue;
-        }
+int token_list_mark(Token_List *list) {
+    return list->current;
+}
 
-        //if keyword
-        if (cmp(text, strl("if"))) {
-            text += strsize("if");
-            i += strsize("if");
-            Token *new = new_token(TK_IF_KW, strl("if"));
-            token_list_add(tokens, new);
-            continue;
-        }
+void token_list_reset(Token_List *list, int mark) {
+    list->current = mark;
+}
 
-        //else keyword
-        if (cmp(text, strl("else"))) {
-            text += strsize("else");
-            i += strsize("else");
-            Token *new = new_token(TK_ELSE_KW, strl("else"));
-            token_list_add(tokens, new);
-            continue;
-        }
+//append a token inside of tokenize, using the local copies of the token list arrays
+//the list is flushed and grown when it is full (rarely, it is reserved up front)
+#define add_token(tk_type, tk_offset, tk_length, tk_id) do { \
+    if (count == capacity) { \
+        tokens->count = count; \
+        token_list_reserve(tokens, capacity * 2); \
+        types = tokens->types; \
+        offsets = tokens->offsets; \
+        lengths = tokens->lengths; \
+        ids = tokens->ids; \
+        capacity = tokens->capacity; \
+    } \
+    types[count] = (tk_type); \
+    offsets[count] = (tk_offset); \
+    lengths[count] = (tk_length); \
+    ids[count] = (tk_id); \
+    count += 1; \
+} while (0)
+
+//outcome of lexing a part of the source
+typedef enum {
+    LEX_OK, LEX_ERROR,
+    //the part ends inside of a block comment (only an error if it is the end of the source)
+    LEX_OPEN_COMMENT,
+} Lex_Status;
+
+typedef struct {
+    Lex_Status status;
+    //error message and position (LEX_ERROR) or start of the open block comment (LEX_OPEN_COMMENT)
+    char *msg;
+    long pos;
+} Lex_Result;
+
+#define lex_error(error_msg, error_pos) do { \
+    result = (Lex_Result) { LEX_ERROR, error_msg, error_pos }; \
+    goto done; \
+} while (0)
+
+//append the tokens of text[start, size) to tokens
+//errors are not printed but returned, so they can be discarded if the part turns out to start inside of a comment
+static Lex_Result lex_range(const unsigned char *text, long start, long size, Token_List *tokens) {
+    //work on local copies, so the compiler does not need to reload them after every store into the arrays
+    Token_Type *types = tokens->types;
+    long *offsets = tokens->offsets;
+    int *lengths = tokens->lengths, *ids = tokens->ids;
+    int count = tokens->count, capacity = tokens->capacity;
+    //identifiers are only interned if the list has an intern table
+    Intern_Table *identifiers = tokens->identifiers;
+    Lex_Result result = { LEX_OK, NULL, 0 };
+
+    long i = start;
+    while (i < size) {
+        unsigned char c = text[i];
+        switch (char_classes[c]) {
+            case CC_WHITESPACE:
+                //single spaces between tokens are handled inline, longer runs (indentation, blank lines) are vectorized
+                i += 1;
+                if (i < size && char_classes[text[i]] == CC_WHITESPACE) {
+                    i += scan_whitespace((const char *) text + i, size - i);
+                }
+                break;
+
+            case CC_ALPHABETICAL: {
+                //identifier or keyword, keywords are only recognized after reading the whole identifier
+                long start = i;
+                i += 1;
+                while (i < size && identifier_chars[text[i]]) {
+                    i += 1;
+                }
+                Token_Type type = keyword_type((const char *) text + start, i - start);
+                int id = type == TK_IDENT && identifiers != NULL ? intern(identifiers, start, i - start) : NO_IDENT;
+                add_token(type, start, i - start, id);
+                break;
+            }
 
-        //braces
-        if (cmp(text, strl("{"))) {
-            text += 1;
-            i += 1;
-            Token *new = new_token(TK_OPEN_BRACE, strl("{"));
-            token_list_add(tokens, new);
-            continue;
-        }
+            case CC_NUMERICAL: {
+                //number literal
+                long start = i;
+                i += 1;
+                while (i < size && char_classes[text[i]] == CC_NUMERICAL) {
+                    i += 1;
+                }
+                add_token(TK_NUM_LITERAL, start, i - start, NO_IDENT);
+                break;
+            }
 
-        if (cmp(text, strl("}"))) {
-            text += 1;
-            i += 1;
-            Token *new = new_token(TK_CLOSE_BRACE, strl("}"));
-            token_list_add(tokens, new);
-            continue;
+            case CC_SINGLE:
+                //braces, parentheses and single character operators
+                add_token(single_char_tokens[c], i, 1, NO_IDENT);
+                i += 1;
+                break;
+
+            case CC_EQUALS:
+                //"==" or "="
+                if (i + 1 < size && text[i + 1] == '=') {
+                    add_token(TK_EQU, i, strsize("=="), NO_IDENT);
+                    i += 2;
+                }
+                else {
+                    add_token(TK_ASSIGN, i, strsize("="), NO_IDENT);
+                    i += 1;
+                }
+                break;
+
+            case CC_EXCLAMATION:
+                if (i + 1 < size && text[i + 1] == '=') {
+                    add_token(TK_NON_EQU, i, strsize("!="), NO_IDENT);
+                    i += 2;
+                    break;
+                }
+                lex_error("unrecognized character", i);
+
+            case CC_SLASH:
+                if (i + 1 < size && text[i + 1] == '/') {
+                    //skip line comments (including the newline)
+                    i += 2;
+                    i += scan_char((const char *) text + i, size - i, '\n') + 1;
+                }
+                else if (i + 1 < size && text[i + 1] == '*') {
+                    //skip block comments (including the terminator)
+                    long comment_size = size - (i + 2);
+                    long end = scan_block_comment_end((const char *) text + i + 2, comment_size);
+                    if (end == comment_size) {
+                        result = (Lex_Result) { LEX_OPEN_COMMENT, "unclosed block comment", i };
+                        goto done;
+                    }
+                    i += 2 + end + 2;
+                }
+                else {
+                    lex_error("unrecognized character", i);
+                }
+                break;
+
+            case CC_NULL:
+                //end of file (compiler error, loop should have ended before reaching eof)
+                lex_error("compiler error (lexer)", i);
+
+            default:
+                lex_error("unrecognized character", i);
         }
+    }
 
-        if (cmp(text, strl("("))) {
-            text += 1;
-            i += 1;
-            Token *new = new_token(TK_OPEN_PAREN, strl("("));
-            token_list_add(tokens, new);
-            continue;
-        }
+done:
+    tokens->count = count;
+    return result;
+}
 
-        if (cmp(text, strl(")"))) {
-            text += 1;
-            i += 1;
-            Token *new = new_token(TK_CLOSE_PAREN, strl(")"));
-            token_list_add(tokens, new);
-            continue;
-        }
+static int estimate_token_count(long size) {
+    long estimate = size / BYTES_PER_TOKEN + TOKEN_LIST_MIN_CAPACITY;
+    return estimate > TOKEN_LIST_MAX_RESERVE ? TOKEN_LIST_MAX_RESERVE : estimate;
+}
 
-        //operators
+static int report(Source *source, Lex_Result result) {
+    if (result.status == LEX_OK) {
+        return 0;
+    }
+    return source_error(source, result.pos, "%s", result.msg);
+}
 
-        //check "==" before "=", so "=" is not matched twice
-        if (cmp(text, strl("=="))) {
-            text += 2;
-            i += 2;
-            Token *new = new_token(TK_EQU, strl("=="));
-            token_list_add(tokens, new);
-            continue;
-        }
+int tokenize(Source *source, Token_List *tokens) {
+    tokens->source = source;
+    if (tokens->identifiers == NULL) {
+        tokens->identifiers = new_intern_table(source->text, source->size);
+    }
+    token_list_reserve(tokens, tokens->count + estimate_token_count(source->size));
+    return report(source, lex_range((const unsigned char *) source->text, 0, source->size, tokens));
+}
 
-        if (cmp(text, strl("!="))) {
-            text += 2;
-            i += 2;
-            Token *new = new_token(TK_NON_EQU, strl("!="));
-            token_list_add(tokens, new);
-            continue;
-        }
+//parallel lexing
+//chunks are lexed without an intern table, identifiers are interned after concatenating the chunks
+//(in source order, so the ids are identical to the ones assigned by tokenize)
+
+typedef struct {
+    Source *source;
+    long start, end;
+    Token_List *tokens;
+    Lex_Result result;
+} Lex_Chunk;
+
+static void lex_chunk(void *arg) {
+    Lex_Chunk *chunk = arg;
+    chunk->tokens = new_token_list();
+    chunk->tokens->source = chunk->source;
+    token_list_reserve(chunk->tokens, estimate_token_count(chunk->end - chunk->start));
+    chunk->result = lex_range((const unsigned char *) chunk->source->text, chunk->start, chunk->end, chunk->tokens);
+}
 
-        if (cmp(text, strl("="))) {
-            text += 1;
-            i += 1;
-            Token *new = new_token(TK_ASSIGN, strl("="));
-            token_list_add(tokens, new);
-            continue;
+int tokenize_parallel(Source *source, Token_List *tokens, Thread_Pool *pool) {
+    long size = source->size;
+    int chunk_count = pool == NULL ? 1 : pool->thread_count;
+    if (size / chunk_count < PARALLEL_MIN_CHUNK_SIZE) {
+        chunk_count = size / PARALLEL_MIN_CHUNK_SIZE;
+    }
+    if (chunk_count <= 1) {
+        return tokenize(source, tokens);
+    }
+    //split right after newlines, so no token (except block comments) can span two chunks
+    Lex_Chunk *chunks = calloc(chunk_count, sizeof(Lex_Chunk));
+    long start = 0;
+    for (int i = 0; i < chunk_count; i++) {
+        long end = size;
+        if (i < chunk_count - 1) {
+            long target = size * (i + 1) / chunk_count;
+            if (target < start) {
+                target = start;
+            }
+            end = target + scan_char(source->text + target, size - target, '\n') + 1;
+            if (end > size) {
+                end = size;
+            }
         }
-
-        if (cmp(text, strl("+"))) {
-            text += 1;
-            i += 1;
-            Token *new = new_token(TK_ADD, strl("+"));
-            token_list_add(tokens, new);
-            continue;
+        chunks[i] = (Lex_Chunk) { source, start, end, NULL, { LEX_OK, NULL, 0 } };
+        start = end;
+        thread_pool_submit(pool, lex_chunk, &chunks[i]);
+    }
+    thread_pool_wait(pool);
+
+    //every chunk was lexed speculatively as if it did not start inside of a block comment
+    //walk the chunks in order and re-lex the ones where that turned out to be wrong
+    int err = 0;
+    int in_comment = 0;
+    long comment_start = 0;
+    int token_count = tokens->count;
+    for (int i = 0; i < chunk_count && !err; i++) {
+        Lex_Chunk *chunk = &chunks[i];
+        if (in_comment) {
+            chunk->tokens->count = 0;
+            long chunk_size = chunk->end - chunk->start;
+            long comment_end = scan_block_comment_end(source->text + chunk->start, chunk_size);
+            if (comment_end == chunk_size) {
+                //whole chunk is part of the comment
+                continue;
+            }
+            chunk->result = lex_range((const unsigned char *) source->text, chunk->start + comment_end + 2, chunk->end, chunk->tokens);
         }
-
-        if (cmp(text, strl("-"))) {
-            text += 1;
-            i += 1;
-            Token *new = new_token(TK_SUB, strl("-"));
-            token_list_add(tokens, new);
-            continue;
+        if (chunk->result.status == LEX_ERROR) {
+            //first error in source order, just like tokenize would report it
+            err = report(source, chunk->result);
         }
+        in_comment = chunk->result.status == LEX_OPEN_COMMENT;
+        comment_start = chunk->result.pos;
+        token_count += chunk->tokens->count;
+    }
+    if (!err && in_comment) {
+        err = source_error(source, comment_start, "unclosed block comment");
+    }
 
-        //number literal
-        int num_lit_size = read_num_literal(text, size - i);
-        if (num_lit_size > 0) {
-            i += num_lit_size;
-            char *new_lit = calloc(num_lit_size + 1, sizeof(char));
-            strncpy(new_lit, text, num_lit_size);
-            text += num_lit_size;
-            Token *new = new_token(TK_NUM_LITERAL, new_lit, num_lit_size);
-            token_list_add(tokens, new);
-            continue;
+    //concatenate the tokens of all chunks
+    if (!err) {
+        tokens->source = source;
+        token_list_reserve(tokens, token_count);
+        int first_new_token = tokens->count;
+        for (int i = 0; i < chunk_count; i++) {
+            Token_List *chunk_tokens = chunks[i].tokens;
+            if (chunk_tokens->count == 0) {
+                continue;
+            }
+            memcpy(tokens->types + tokens->count, chunk_tokens->types, chunk_tokens->count * sizeof(Token_Type));
+            memcpy(tokens->offsets + tokens->count, chunk_tokens->offsets, chunk_tokens->count * sizeof(long));
+            memcpy(tokens->lengths + tokens->count, chunk_tokens->lengths, chunk_tokens->count * sizeof(int));
+            tokens->count += chunk_tokens->count;
         }
-
-        //identifier
-        int ident_size = read_identifier(text, size - i);
-        if (ident_size > 0) {
-            i += ident_size;
-            char *new_ident = calloc(ident_size + 1, sizeof(char));
-            strncpy(new_ident, text, ident_size);
-            text += ident_size;
-            Token *new = new_token(TK_IDENT, new_ident, ident_size);
-            token_list_add(tokens, new);
-            continue;
+        if (tokens->identifiers == NULL) {
+            tokens->identifiers = new_intern_table(source->text, source->size);
         }
-
-        //end of file (compiler error, loop should have ended before reaching eof)
-        if (cmp(text, strl("\0"))) {
-            return error("compiler error (lexer)", text_start, i);
+        for (int i = first_new_token; i < tokens->count; i++) {
+            tokens->ids[i] = tokens->types[i] == TK_IDENT ? intern(tokens->identifiers, tokens->offsets[i], tokens->lengths[i]) : NO_IDENT;
         }
-
-        return error("unrecognized character", text_start, i);
     }
-    return 0;
+    for (int i = 0; i < chunk_count; i++) {
+        free_token_list(chunks[i].tokens);
+    }
+    free(chunks);
+    return err;
 }
@@ -1,49 +1,85 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "pool.h"
+#include "intern.h"
+#include "source.h"
+
 typedef enum {
     TK_FUNC_KW, TK_IF_KW, TK_ELSE_KW, TK_IDENT, TK_NUM_LITERAL, TK_ASSIGN, TK_ADD, TK_SUB, TK_EQU, TK_NON_EQU, TK_OPEN_BRACE, TK_CLOSE_BRACE, TK_OPEN_PAREN, TK_CLOSE_PAREN,
+    //returned when reading past the last token, never stored in a token list
+    TK_EOF,
 } Token_Type;
 
-typedef struct Token {
-    Token_Type type;
-    char *value;
-    int value_size;
-} Token;
+//tokens are referred to by their index in the token list
+#define NO_TOKEN -1
 
-Token *new_token(Token_Type type, char *value, int value_size);
+//growable token stream stored as struct of arrays (one entry per token in each array)
+//a token is a view (offset, length) into the source buffer
+//identifiers additionally have an interned id (ids), which is NO_IDENT for all other tokens
+typedef struct {
+    Token_Type *types;
+    long *offsets;
+    int *lengths, *ids;
+    int count, capacity;
+    //index of the current token, == count when all tokens are consumed
+    int current;
+    //set by tokenize
+    Source *source;
+    Intern_Table *identifiers;
+} Token_List;
 
-void free_token(Token *token);
+Token_List *new_token_list();
 
-int token_equals(Token *first, Token *second);
+void free_token_list(Token_List *list);
 
-typedef struct Token_List_Node {
-    struct Token_List_Node *next, *previous;
-    Token *token;
-} Token_List_Node;
+//make sure the list can hold at least capacity tokens without growing
+void token_list_reserve(Token_List *list, int capacity);
 
-Token_List_Node *new_token_list_node(Token *token);
+//append token and return its index
+int token_list_add(Token_List *list, Token_Type type, long offset, int length);
 
-void free_token_list_node(Token_List_Node *node);
+Token_Type token_type(Token_List *list, int token);
 
-typedef struct {
-    Token_List_Node *root, *current, *last;
-} Token_List;
+//first character of the token inside the source buffer
+//important: not null terminated, print with "%.*s" and token_fmt()
+const char *token_value(Token_List *list, int token);
 
-Token_List *new_token_list();
+//expands to the two arguments of a "%.*s" format specifier
+#define token_fmt(list, token) (list)->lengths[token], token_value(list, token)
 
-void free_token_list(Token_List *list);
+//interned id of an identifier token, NO_IDENT for other tokens
+int token_id(Token_List *list, int token);
+
+//compare two identifier tokens by their interned ids
+int token_equals(Token_List *list, int first, int second);
+
+//index of the current token, NO_TOKEN if all tokens are consumed
+int token_list_current(Token_List *list);
 
-void token_list_add(Token_List *list, Token *new);
+//type of the current token, TK_EOF if all tokens are consumed
+Token_Type token_list_current_type(Token_List *list);
 
-Token *token_list_current(Token_List *list);
+//type of the token after the current one, TK_EOF if there is none
+Token_Type token_list_lookahead_type(Token_List *list);
 
-Token *token_list_next(Token_List *list);
+//return current and forward
+int token_list_next(Token_List *list);
 
+//just forward
 void token_list_forward(Token_List *list);
 
 void token_list_rewind(Token_List *list, int distance);
 
-int tokenize(char *text, int size, Token_List *tokens);
+//remember the current position to return to it later using token_list_reset
+int token_list_mark(Token_List *list);
+
+void token_list_reset(Token_List *list, int mark);
+
+int tokenize(Source *source, Token_List *tokens);
+
+//like tokenize, but split the source at newlines into one chunk per thread of the pool and lex the chunks in parallel
+//the resulting tokens are identical to the ones of tokenize (small inputs are lexed serially)
+int tokenize_parallel(Source *source, Token_List *tokens, Thread_Pool *pool);
 
 #endif
@@ -1,65 +1,162 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/stat.h>
-#include "lexer.h"
-#include "parser.h"
-#include "symbol.h"
-#include "analysis.h"
-#include "codegen.h"
+#include "compiler.h"
 
+#define strl(str) str, sizeof(str) - 1
+#define strsize(str) sizeof(str) - 1
+
+//usage: compiler [options] input_file
+//input_file "-" reads the program from stdin
+//
+//options:
+//--lex-threads=N   lex the input on N threads (default: 1)
+//--parse-threads=N parse top-level statements on N threads (default: 1)
+//--analysis-threads=N check the bodies of top-level functions on N threads (default: 1)
+//--huge-pages      back the AST and symbol arenas with huge pages
+//--arena-stats     print the allocation counters of the arenas
+//--ast-cache=DIR   reuse the tokens and AST of an unchanged input from DIR (and store them there otherwise)
+//--analysis-cache=DIR reuse the analysis results of unchanged top-level functions from DIR (and store all of them there)
+//--analysis-stats  print how many functions were reused from the analysis cache
+//--out-dir=DIR     write the executable out (and out.asm) to DIR (default: out)
+//--emit-asm        also write the generated assembly (nasm syntax) to out.asm
+//--run             run the program in process right after compiling it, no executable is written
+//--interpret       interpret the program as bytecode right after compiling it, no machine code or executable is generated
 int main(int argc, char **argv) {
-    if (argc != 2) {
+    char *input_path = NULL;
+    char *out_dir = "out";
+    int emit_asm = 0;
+    Compiler_Context *context = new_compiler_context();
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], strl("--lex-threads=")) == 0) {
+            context->lex_threads = atoi(argv[i] + strsize("--lex-threads="));
+            if (context->lex_threads < 1) {
+                printf("ERROR: invalid thread count %s!\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], strl("--parse-threads=")) == 0) {
+            context->parse_threads = atoi(argv[i] + strsize("--parse-threads="));
+            if (context->parse_threads < 1) {
+                printf("ERROR: invalid thread count %s!\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], strl("--analysis-threads=")) == 0) {
+            context->analysis_threads = atoi(argv[i] + strsize("--analysis-threads="));
+            if (context->analysis_threads < 1) {
+                printf("ERROR: invalid thread count %s!\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], strl("--ast-cache=")) == 0) {
+            context->ast_cache_dir = argv[i] + strsize("--ast-cache=");
+        }
+        else if (strncmp(argv[i], strl("--analysis-cache=")) == 0) {
+            context->analysis_cache_dir = argv[i] + strsize("--analysis-cache=");
+        }
+        else if (strncmp(argv[i], strl("--out-dir=")) == 0) {
+            out_dir = argv[i] + strsize("--out-dir=");
+        }
+        else if (strcmp(argv[i], "--run") == 0) {
+            context->run = 1;
+        }
+        else if (strcmp(argv[i], "--interpret") == 0) {
+            context->interpret = 1;
+        }
+        else if (strcmp(argv[i], "--emit-asm") == 0) {
+            emit_asm = 1;
+        }
+        else if (strcmp(argv[i], "--huge-pages") == 0) {
+            context->arena_flags |= ARENA_HUGE_PAGES;
+        }
+        else if (strcmp(argv[i], "--arena-stats") == 0) {
+            context->arena_stats = 1;
+        }
+        else if (strcmp(argv[i], "--analysis-stats") == 0) {
+            context->analysis_stats = 1;
+        }
+        else if (input_path == NULL) {
+            input_path = argv[i];
+        }
+        else {
+            printf("ERROR: unexpected argument %s!\n", argv[i]);
+            return 1;
+        }
+    }
+    if (input_path == NULL) {
         printf("ERROR: please specify input file!\n");
         return 1;
     }
 
+    //--run and --interpret write nothing unless the assembly is requested
+    int executes = context->run || context->interpret;
+    int writes_files = !executes || emit_asm;
     struct stat st = { 0 };
-    if (stat("out", &st) == -1) {
-        if (mkdir("out", 0777) == -1) {
+    if (writes_files && stat(out_dir, &st) == -1) {
+        if (mkdir(out_dir, 0777) == -1) {
             printf("ERROR: could not create output directory!\n");
             return 1;
         }
     }
 
-    FILE *file = fopen(argv[1], "r");
-    fseek(file, 0, SEEK_END);
-    int file_size = ftell(file);
-    rewind(file);
-    char *text = malloc(file_size);
-    fread(text, file_size, sizeof(char), file);
-    fclose(file);
-
-    //TODO use unified/consistent error handling for each compiler step
-
-    int err;
-
-    Token_List *tokens = new_token_list();
-    err = tokenize(text, file_size, tokens);
-    if (err) {
-        printf("Error while running lexer\n");
+    Source *source = read_source(input_path);
+    if (source == NULL) {
         return 1;
     }
 
-    AST_Node *ast = parse(tokens);
-
-    Symbol_Table *table = new_symbol_table();
-    err = semantic_analysis(ast, table);
-    if (err) {
-        printf("Error while running semantic analysis\n");
-        return 1;
+    //room for the directory and a file name
+    int path_size = strlen(out_dir) + 64;
+    char *path = malloc(path_size);
+    FILE *asm_file = NULL;
+    if (emit_asm) {
+        snprintf(path, path_size, "%s/out.asm", out_dir);
+        asm_file = fopen(path, "w");
+        if (asm_file == NULL) {
+            printf("ERROR: could not open output file %s!\n", path);
+            return 1;
+        }
     }
-
-    FILE *asm_file = fopen("out/out.asm", "w");
-    err = codegen(ast, table, asm_file);
+    //the executable is written next to out and only replaces it once the compilation succeeded,
+    //a failed compilation leaves the previous executable in place
+    if (!executes) {
+        snprintf(path, path_size, "%s/out.tmp", out_dir);
+        int executable_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0777);
+        if (executable_fd == -1) {
+            printf("ERROR: could not open output file %s!\n", path);
+            return 1;
+        }
+        context->executable_file = fdopen(executable_fd, "w");
+    }
+    int err = compile(context, source, asm_file);
+    if (context->executable_file != NULL) {
+        char *out_path = malloc(path_size);
+        snprintf(out_path, path_size, "%s/out", out_dir);
+        if (fclose(context->executable_file) != 0 && !err) {
+            printf("ERROR: could not write output file %s!\n", path);
+            err = 1;
+        }
+        if (err) {
+            unlink(path);
+        }
+        else if (rename(path, out_path) == -1) {
+            printf("ERROR: could not write output file %s!\n", out_path);
+            unlink(path);
+            err = 1;
+        }
+        free(out_path);
+    }
+    if (asm_file != NULL) {
+        fclose(asm_file);
+    }
+    free_compiler_context(context);
+    free(path);
     if (err) {
-        printf("Error while running codegen\n");
         return 1;
     }
-    fclose(asm_file);
-
-    system("nasm -o out/out.o -f elf64 out/out.asm");
-    system("ld -o out/out out/out.o");
 
     return 0;
 }
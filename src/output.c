@@ -0,0 +1,94 @@
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include "output.h"
+
+//longest decimal representation of a long (sign included)
+#define MAX_DIGITS 20
+
+Output_Buffer *new_output_buffer(int fd) {
+    Output_Buffer *new = malloc(sizeof(Output_Buffer));
+    new->capacity = fd == NO_FD ? OUTPUT_MEMORY_SIZE : OUTPUT_BUFFER_SIZE;
+    new->data = malloc(new->capacity);
+    new->size = 0;
+    new->fd = fd;
+    new->error = 0;
+    return new;
+}
+
+void free_output_buffer(Output_Buffer *buffer) {
+    free(buffer->data);
+    free(buffer);
+}
+
+//write all of [bytes, bytes + size) to fd, return 1 on failure
+static int write_all(int fd, const char *bytes, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return 1;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return 0;
+}
+
+int output_flush(Output_Buffer *buffer) {
+    if (buffer->fd != NO_FD && buffer->size > 0) {
+        if (!buffer->error && write_all(buffer->fd, buffer->data, buffer->size)) {
+            buffer->error = 1;
+        }
+        buffer->size = 0;
+    }
+    return buffer->error;
+}
+
+int output_write_file(Output_Buffer *buffer, FILE *file) {
+    fflush(file);
+    int fd = fileno(file);
+    if (fd < 0) {
+        fwrite(buffer->data, 1, buffer->size, file);
+        return ferror(file) != 0;
+    }
+    return write_all(fd, buffer->data, buffer->size);
+}
+
+void output_bytes_slow(Output_Buffer *buffer, const char *bytes, size_t size) {
+    if (buffer->fd == NO_FD) {
+        size_t capacity = buffer->capacity * 2;
+        if (capacity < buffer->size + size) {
+            capacity = buffer->size + size;
+        }
+        buffer->data = realloc(buffer->data, capacity);
+        buffer->capacity = capacity;
+    }
+    else {
+        output_flush(buffer);
+        //too large for the buffer, write it right away
+        if (size > buffer->capacity) {
+            if (!buffer->error && write_all(buffer->fd, bytes, size)) {
+                buffer->error = 1;
+            }
+            return;
+        }
+    }
+    memcpy(buffer->data + buffer->size, bytes, size);
+    buffer->size += size;
+}
+
+void output_int(Output_Buffer *buffer, long value) {
+    //digits are generated backwards from the end of digits
+    char digits[MAX_DIGITS];
+    char *first = digits + MAX_DIGITS;
+    unsigned long magnitude = value < 0 ? -(unsigned long) value : (unsigned long) value;
+    do {
+        *--first = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) {
+        *--first = '-';
+    }
+    output_bytes(buffer, first, digits + MAX_DIGITS - first);
+}
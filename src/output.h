@@ -0,0 +1,65 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <string.h>
+
+//buffered writer for the generated code
+//output is collected in one large user space buffer and written to a file descriptor with large write() calls,
+//a buffer without a file descriptor grows instead and keeps the whole output in memory
+//important: not thread safe, use one buffer per thread
+
+//size of the buffer of a file descriptor, initial size of a memory buffer
+#define OUTPUT_BUFFER_SIZE (1024 * 1024)
+#define OUTPUT_MEMORY_SIZE 256
+#define NO_FD -1
+
+typedef struct {
+    //[0, size) is buffered and not written yet
+    char *data;
+    size_t size, capacity;
+    //file descriptor the buffer is flushed to, NO_FD for a memory buffer
+    int fd;
+    //set after a failed write, later output is dropped
+    int error;
+} Output_Buffer;
+
+Output_Buffer *new_output_buffer(int fd);
+
+//release the buffer, unflushed output is lost
+void free_output_buffer(Output_Buffer *buffer);
+
+//write everything buffered to the file descriptor (nothing to do for a memory buffer), return 1 if any write failed
+int output_flush(Output_Buffer *buffer);
+
+//write the whole content of a memory buffer to file, return 1 on failure
+//files with a file descriptor get it with a single write() (if the kernel takes it at once), anything else (e.g. memory streams) with fwrite
+int output_write_file(Output_Buffer *buffer, FILE *file);
+
+//slow path of output_bytes, flushes or grows the buffer
+void output_bytes_slow(Output_Buffer *buffer, const char *bytes, size_t size);
+
+static inline void output_bytes(Output_Buffer *buffer, const char *bytes, size_t size) {
+    if (size > buffer->capacity - buffer->size) {
+        output_bytes_slow(buffer, bytes, size);
+        return;
+    }
+    memcpy(buffer->data + buffer->size, bytes, size);
+    buffer->size += size;
+}
+
+static inline void output_char(Output_Buffer *buffer, char c) {
+    if (buffer->size == buffer->capacity) {
+        output_bytes_slow(buffer, &c, 1);
+        return;
+    }
+    buffer->data[buffer->size++] = c;
+}
+
+//write a string literal (the length is known at compile time)
+#define output_literal(buffer, literal) output_bytes(buffer, literal, sizeof(literal) - 1)
+
+//write value in decimal
+void output_int(Output_Buffer *buffer, long value);
+
+#endif
@@ -3,447 +3,358 @@
 #include "lexer.h"
 #include "parser.h"
 
-AST_Node *new_ast_node(Token *token, AST_Node_Type type) {
-    AST_Node *new = malloc(sizeof(AST_Node));
+AST_Node *new_ast_node(Arena *arena, int token, AST_Node_Type type) {
+    AST_Node *new = arena_alloc(arena, sizeof(AST_Node));
     new->lhs = NULL;
     new->rhs = NULL;
     new->ms = NULL;
     new->children = NULL;
+    new->last_child = NULL;
+    new->child_count = 0;
     new->next = NULL;
     new->node_type = type;
     new->token = token;
     return new;
 }
 
-void free_ast_node(AST_Node *node) {
-    if (node != NULL) {
-        free(node);
-    }
-}
-
-void free_ast_node_recursive(AST_Node *node) {
-    if (node->lhs != NULL) {
-        free_ast_node_recursive(node->lhs);
-    }
-    if (node->ms != NULL) {
-        free_ast_node_recursive(node->ms);
-    }
-    if (node->rhs != NULL) {
-        free_ast_node_recursive(node->rhs);
+void ast_node_add_child(AST_Node *parent, AST_Node *new_child) {
+    if (parent->children == NULL) {
+        parent->children = new_child;
     }
-    if (node->children != NULL) {
-        free_ast_node_list_recursive(node->children);
+    else {
+        parent->last_child->next = new_child;
     }
-    free_ast_node(node);
+    parent->last_child = new_child;
+    parent->child_count += 1;
 }
 
-void free_ast_node_list(AST_Node *node) {
-    while (node != NULL) {
-        AST_Node *next = node->next;
-        free_ast_node(node);
-        node = next;
-    }
-}
+//the grammar is LL(1): every production is chosen by the current token (statements starting with an identifier
+//additionally look at the next token), so the parser never backtracks and runs in linear time
+//all productions return NULL after reporting a syntax error
 
-void free_ast_node_list_recursive(AST_Node *node) {
-    while (node != NULL) {
-        AST_Node *next = node->next;
-        free_ast_node_recursive(node);
-        node = next;
-    }
-}
-
-void ast_node_add_child(AST_Node *parent, AST_Node *new_child) {
-    if (parent->children == NULL) {
-        parent->children = new_child;
+//report a syntax error at the current token (or the end of the input) and return NULL
+static AST_Node *syntax_error(Token_List *tokens, char *expected) {
+    int token = token_list_current(tokens);
+    if (token == NO_TOKEN) {
+        source_error(tokens->source, tokens->source->size, "expected %s, found end of input", expected);
     }
     else {
-        AST_Node *children = parent->children;
-        while (children->next != NULL) {
-            children = children->next;
-        }
-        children->next = new_child;
+        source_error(tokens->source, tokens->offsets[token], "expected %s, found %.*s", expected, token_fmt(tokens, token));
     }
+    return NULL;
 }
 
-/* void error(char *msg) {
-    printf("ERROR: %msg\n");
-    exit(1);
-} */
+//consume the current token if it has the expected type and return its index, NO_TOKEN (after reporting an error) otherwise
+static int expect(Token_List *tokens, Token_Type type, char *expected) {
+    if (token_list_current_type(tokens) != type) {
+        syntax_error(tokens, expected);
+        return NO_TOKEN;
+    }
+    return token_list_next(tokens);
+}
 
 //summand = ident | num_literal
-AST_Node *summand(Token_List *tokens) {
-    Token *token = token_list_current(tokens);
-    if (token == NULL) return NULL;
+AST_Node *summand(Token_List *tokens, Arena *arena) {
+    int token = token_list_current(tokens);
+    Token_Type type = token_type(tokens, token);
     AST_Node *summand;
-    if (token->type == TK_IDENT) {
-        summand = new_ast_node(token, ND_VAR);
+    if (type == TK_IDENT) {
+        summand = new_ast_node(arena, token, ND_VAR);
     }
-    else if (token->type == TK_NUM_LITERAL) {
-        summand = new_ast_node(token, ND_INT);
+    else if (type == TK_NUM_LITERAL) {
+        summand = new_ast_node(arena, token, ND_INT);
     }
     else {
-        return NULL;
+        return syntax_error(tokens, "identifier or number");
     }
     token_list_forward(tokens);
     return summand;
 }
 
 //expression = summand "+" summand | summand "-" summand | summand
-AST_Node *expression(Token_List *tokens) {
+AST_Node *expression(Token_List *tokens, Arena *arena) {
     //all alternatives have first summand in common
-    AST_Node *s1 = summand(tokens);
+    AST_Node *s1 = summand(tokens, arena);
     if (s1 == NULL) return NULL;
 
     //operand
-    Token *token = token_list_current(tokens);
+    int token = token_list_current(tokens);
+    Token_Type type = token_type(tokens, token);
     AST_Node *op;
-    if (token == NULL) {
-        return s1;
+    if (type == TK_ADD) {
+        op = new_ast_node(arena, token, ND_ADD);
     }
-    if (token->type == TK_ADD) {
-        op = new_ast_node(token, ND_ADD);
-    }
-    else if (token->type == TK_SUB) {
-        op = new_ast_node(token, ND_SUB);
+    else if (type == TK_SUB) {
+        op = new_ast_node(arena, token, ND_SUB);
     }
     else {
         //no operand found, but single summand is still a valid expression
         return s1;
     }
-
     token_list_forward(tokens);
 
     //second summand
-    AST_Node *s2 = summand(tokens);
-    if (s2 == NULL) {
-        //rewind already consumed operator and free its AST node
-        token_list_rewind(tokens, 1);
-        free_ast_node(op);
-        return s1;
-    }
+    AST_Node *s2 = summand(tokens, arena);
+    if (s2 == NULL) return NULL;
     op->lhs = s1;
     op->rhs = s2;
     return op;
 }
 
 //call = identifier "()"
-AST_Node *call(Token_List *tokens) {
-    //identifier
-    Token *id_token = token_list_current(tokens);
-    if (id_token == NULL || id_token->type != TK_IDENT) {
-        return NULL;
-    }
-    token_list_forward(tokens);
-
-    Token *token;
-    //open parenthesis
-    token = token_list_current(tokens);
-    if (token == NULL || token->type != TK_OPEN_PAREN) {
-        token_list_rewind(tokens, 1);
-        return NULL;
-    }
-    token_list_forward(tokens);
-
-    //close parenthesis
-    token = token_list_current(tokens);
-    if (token == NULL || token->type != TK_CLOSE_PAREN) {
-        token_list_rewind(tokens, 2);
-        return NULL;
-    }
-    token_list_forward(tokens);
-
-    return new_ast_node(id_token, ND_FUNCTION_CALL);
+AST_Node *call(Token_List *tokens, Arena *arena) {
+    int id_token = expect(tokens, TK_IDENT, "identifier");
+    if (id_token == NO_TOKEN) return NULL;
+    if (expect(tokens, TK_OPEN_PAREN, "(") == NO_TOKEN) return NULL;
+    if (expect(tokens, TK_CLOSE_PAREN, ")") == NO_TOKEN) return NULL;
+    return new_ast_node(arena, id_token, ND_FUNCTION_CALL);
 }
 
 //assignment = identifier "=" expression
-AST_Node *assignment(Token_List *tokens) {
-    //identifier
-    Token *id_token = token_list_current(tokens);
-    if (id_token == NULL || id_token->type != TK_IDENT) {
-        return NULL;
-    }
-    token_list_forward(tokens);
-
-    //equal sign
-    Token *equ_token = token_list_current(tokens);
-    if (equ_token == NULL || equ_token->type != TK_ASSIGN) {
-        token_list_rewind(tokens, 1);
-        return NULL;
-    }
-    token_list_forward(tokens);
+AST_Node *assignment(Token_List *tokens, Arena *arena) {
+    int id_token = expect(tokens, TK_IDENT, "identifier");
+    if (id_token == NO_TOKEN) return NULL;
+    int equ_token = expect(tokens, TK_ASSIGN, "=");
+    if (equ_token == NO_TOKEN) return NULL;
 
-    //expression
-    AST_Node *expr = expression(tokens);
-    if (expr == NULL) {
-        token_list_rewind(tokens, 2);
-        return NULL;
-    }
+    AST_Node *expr = expression(tokens, arena);
+    if (expr == NULL) return NULL;
 
-    AST_Node *var = new_ast_node(id_token, ND_VAR);
-    AST_Node *assign = new_ast_node(equ_token, ND_ASSIGN);
+    AST_Node *var = new_ast_node(arena, id_token, ND_VAR);
+    AST_Node *assign = new_ast_node(arena, equ_token, ND_ASSIGN);
     assign->lhs = var;
     assign->rhs = expr;
     return assign;
 }
 
-AST_Node *statement(Token_List *tokens);
+AST_Node *statement(Token_List *tokens, Arena *arena);
 
-//function = "function" identifier "{" { statement } "}"
-AST_Node *function(Token_List *tokens) {
-    //function keyword
-    Token *token = token_list_current(tokens);
-    if (token == NULL || token->type != TK_FUNC_KW) {
-        return NULL;
-    }
-    Token_List_Node *token_reset = tokens->current; //return to this token if production can't be matched
-    token_list_forward(tokens);
+//block = "{" { statement } "}"
+//the statements are appended to the children of parent, return 1 after a syntax error
+static int block(Token_List *tokens, Arena *arena, AST_Node *parent) {
+    if (expect(tokens, TK_OPEN_BRACE, "{") == NO_TOKEN) return 1;
 
-    //identifier
-    Token *id_token = token_list_current(tokens);
-    if (id_token == NULL || id_token->type != TK_IDENT) {
-        token_list_rewind(tokens, 1);
-        return NULL;
-    }
-    token_list_forward(tokens);
-
-    //open brace
-    token = token_list_current(tokens);
-    if (token == NULL || token->type != TK_OPEN_BRACE) {
-        token_list_rewind(tokens, 2);
-        return NULL;
-    }
-    token_list_forward(tokens);
-
-    //statements
-    AST_Node *statements = NULL, *current_statement = NULL, *new_statement = NULL;
-    while ((new_statement = statement(tokens)) != NULL) {
-        if (statements == NULL) {
-            statements = new_statement;
-            current_statement = new_statement;
-        }
-        else {
-            current_statement->next = new_statement;
-            current_statement = new_statement;
+    while (token_list_current_type(tokens) != TK_CLOSE_BRACE) {
+        if (token_list_current(tokens) == NO_TOKEN) {
+            syntax_error(tokens, "}");
+            return 1;
         }
-    }
-
-    //close brace
-    token = token_list_current(tokens);
-    if (token == NULL || token->type != TK_CLOSE_BRACE) {
-        tokens->current = token_reset; //cannot rewind a known distance because statement count is unknown at compile time
-        free_ast_node_list_recursive(statements);
-        return NULL;
+        AST_Node *new_statement = statement(tokens, arena);
+        if (new_statement == NULL) return 1;
+        ast_node_add_child(parent, new_statement);
     }
     token_list_forward(tokens);
+    return 0;
+}
+
+//function = "function" identifier block
+AST_Node *function(Token_List *tokens, Arena *arena) {
+    if (expect(tokens, TK_FUNC_KW, "function") == NO_TOKEN) return NULL;
+    int id_token = expect(tokens, TK_IDENT, "function name");
+    if (id_token == NO_TOKEN) return NULL;
 
-    AST_Node *function = new_ast_node(id_token, ND_FUNCTION_DEF);
-    function->children = statements;
+    AST_Node *function = new_ast_node(arena, id_token, ND_FUNCTION_DEF);
+    if (block(tokens, arena, function)) return NULL;
     return function;
 }
 
 //boolean = summand "==" summand | summand "!=" summand
-AST_Node *boolean(Token_List *tokens) {
-    //return to this token if production can't be matched
-    Token_List_Node *token_reset = tokens->current;
-
+AST_Node *boolean(Token_List *tokens, Arena *arena) {
     //first summand
-    AST_Node *s1 = summand(tokens);
+    AST_Node *s1 = summand(tokens, arena);
     if (s1 == NULL) return NULL;
 
     //operand
-    Token *token = token_list_current(tokens);
-    AST_Node *op;
-    if (token == NULL) {
-        tokens->current = token_reset;
-        free_ast_node(s1);
-        return NULL;
-    }
-    if (token->type == TK_EQU) {
-        op = new_ast_node(token, ND_BOOLEAN);
-    }
-    else if (token->type == TK_NON_EQU) {
-        op = new_ast_node(token, ND_BOOLEAN);
+    int token = token_list_current(tokens);
+    Token_Type type = token_type(tokens, token);
+    if (type != TK_EQU && type != TK_NON_EQU) {
+        return syntax_error(tokens, "== or !=");
     }
-    else {
-        tokens->current = token_reset;
-        free_ast_node(s1);
-        return NULL;
-    }
-
+    AST_Node *op = new_ast_node(arena, token, ND_BOOLEAN);
     token_list_forward(tokens);
 
     //second summand
-    AST_Node *s2 = summand(tokens);
-    if (s2 == NULL) {
-        tokens->current = token_reset;
-        free_ast_node(s1);
-        free_ast_node(op);
-        return NULL;
-    }
+    AST_Node *s2 = summand(tokens, arena);
+    if (s2 == NULL) return NULL;
     op->lhs = s1;
     op->rhs = s2;
     return op;
 }
 
-//condition = "if" "(" boolean ")" "{" {statement} "}" [else "{" {statement} "}"]
-AST_Node *condition(Token_List *tokens) {
-    //return to this token if production can't be matched
-    Token_List_Node *token_reset = tokens->current;
-
-    //if keyword
-    Token *token = token_list_current(tokens);
-    if (token == NULL || token->type != TK_IF_KW) {
-        return NULL;
-    }
-    token_list_forward(tokens);
-
-    //open parenthesis
-    token = token_list_current(tokens);
-    if (token == NULL || token->type != TK_OPEN_PAREN) {
-        tokens->current = token_reset;
-        return NULL;
-    }
-    token_list_forward(tokens);
+//condition = "if" "(" boolean ")" block ["else" block]
+AST_Node *condition(Token_List *tokens, Arena *arena) {
+    if (expect(tokens, TK_IF_KW, "if") == NO_TOKEN) return NULL;
+    if (expect(tokens, TK_OPEN_PAREN, "(") == NO_TOKEN) return NULL;
 
     //actual condition/boolean
-    AST_Node *bool = boolean(tokens);
-    if (bool == NULL) {
-        tokens->current = token_reset;
-        return NULL;
-    }
-
-    //close parenthesis
-    token = token_list_current(tokens);
-    if (token == NULL || token->type != TK_CLOSE_PAREN) {
-        tokens->current = token_reset;
-        free_ast_node_recursive(bool);
-        return NULL;
-    }
-    token_list_forward(tokens);
-
-    //open brace
-    token = token_list_current(tokens);
-    if (token == NULL || token->type != TK_OPEN_BRACE) {
-        tokens->current = token_reset;
-        free_ast_node_recursive(bool);
-        return NULL;
-    }
-    token_list_forward(tokens);
+    AST_Node *bool = boolean(tokens, arena);
+    if (bool == NULL) return NULL;
 
-    //statements
-    AST_Node *statements_if = NULL, *current_statement_if = NULL, *new_statement_if = NULL;
-    while ((new_statement_if = statement(tokens)) != NULL) {
-        if (statements_if == NULL) {
-            statements_if = new_statement_if;
-            current_statement_if = new_statement_if;
-        }
-        else {
-            current_statement_if->next = new_statement_if;
-            current_statement_if = new_statement_if;
-        }
-    }
-
-    //close brace
-    token = token_list_current(tokens);
-    if (token == NULL || token->type != TK_CLOSE_BRACE) {
-        tokens->current = token_reset;
-        free_ast_node_recursive(bool);
-        free_ast_node_list_recursive(statements_if);
-        return NULL;
-    }
-    token_list_forward(tokens);
+    if (expect(tokens, TK_CLOSE_PAREN, ")") == NO_TOKEN) return NULL;
 
-    //if else cannot be matched, reset to still valid if match
-    token_reset = tokens->current;
+    AST_Node *cond_true = new_ast_node(arena, NO_TOKEN, ND_COND_TRUE);
+    if (block(tokens, arena, cond_true)) return NULL;
 
-    AST_Node *cond = new_ast_node(NULL, ND_COND);
-    AST_Node *cond_true = new_ast_node(NULL, ND_COND_TRUE);
-    cond_true->children = statements_if;
+    AST_Node *cond = new_ast_node(arena, NO_TOKEN, ND_COND);
     cond->lhs = cond_true;
     cond->ms = bool;
 
-    //else keyword
-    token = token_list_current(tokens);
-    if (token == NULL || token->type != TK_ELSE_KW) {
-        tokens->current = token_reset;
+    //optional else
+    if (token_list_current_type(tokens) != TK_ELSE_KW) {
         return cond;
     }
     token_list_forward(tokens);
 
-    //open brace
-    token = token_list_current(tokens);
-    if (token == NULL || token->type != TK_OPEN_BRACE) {
-        tokens->current = token_reset;
-        return cond;
-    }
-    token_list_forward(tokens);
-
-    //statements
-    AST_Node *statements_else = NULL, *current_statement_else = NULL, *new_statement_else = NULL;
-    while ((new_statement_else = statement(tokens)) != NULL) {
-        if (statements_else == NULL) {
-            statements_else = new_statement_else;
-            current_statement_else = new_statement_else;
-        }
-        else {
-            current_statement_else->next = new_statement_else;
-            current_statement_else = new_statement_else;
-        }
-    }
-
-    //close brace
-    token = token_list_current(tokens);
-    if (token == NULL || token->type != TK_CLOSE_BRACE) {
-        tokens->current = token_reset;
-        free_ast_node_list_recursive(statements_else);
-        return cond;
-    }
-    token_list_forward(tokens);
-
-    AST_Node *cond_false = new_ast_node(NULL, ND_COND_FALSE);
-    cond_false->children = statements_else;
+    AST_Node *cond_false = new_ast_node(arena, NO_TOKEN, ND_COND_FALSE);
+    if (block(tokens, arena, cond_false)) return NULL;
     cond->rhs = cond_false;
 
     return cond;
 }
 
 //statement = assignment | call | function | condition
-AST_Node *statement(Token_List *tokens) {
-    AST_Node *node = assignment(tokens);
-    if (node != NULL) {
-        return node;
-    }
-
-    node = call(tokens);
-    if (node != NULL) {
-        return node;
+AST_Node *statement(Token_List *tokens, Arena *arena) {
+    switch (token_list_current_type(tokens)) {
+        case TK_IDENT:
+            //assignment and call both start with an identifier, the next token decides
+            switch (token_list_lookahead_type(tokens)) {
+                case TK_ASSIGN:
+                    return assignment(tokens, arena);
+                case TK_OPEN_PAREN:
+                    return call(tokens, arena);
+                default:
+                    token_list_forward(tokens);
+                    return syntax_error(tokens, "= or (");
+            }
+        case TK_FUNC_KW:
+            return function(tokens, arena);
+        case TK_IF_KW:
+            return condition(tokens, arena);
+        default:
+            return syntax_error(tokens, "statement");
     }
+}
 
-    node = function(tokens);
-    if (node != NULL) {
-        return node;
+//S = { statement }
+AST_Node *parse(Token_List *tokens, Arena *arena) {
+    AST_Node *root = new_ast_node(arena, NO_TOKEN, ND_ROOT);
+    while (token_list_current(tokens) != NO_TOKEN) {
+        AST_Node *new_statement = statement(tokens, arena);
+        if (new_statement == NULL) return NULL;
+        ast_node_add_child(root, new_statement);
     }
+    return root;
+}
 
-    return condition(tokens);
+//parallel parsing
+//the tokens are split into batches of top-level statements, every batch is parsed on its own (on a view of the token list,
+//into its own arena) and the statements of all batches are appended to the root in source order
+
+//minimum amount of tokens per batch, smaller inputs are parsed serially
+#define PARALLEL_MIN_BATCH_TOKENS (64 * 1024)
+//more batches than threads, so idle workers can steal the remaining ones if the batches are uneven
+#define BATCHES_PER_THREAD 4
+
+typedef struct {
+    //view of the batch: current is its first token, count its end
+    Token_List tokens;
+    //silent copy of the source, syntax errors are reported by the serial fallback
+    Source source;
+    Arena *arena;
+    AST_Node *root;
+} Parse_Batch;
+
+static void parse_batch(void *arg) {
+    Parse_Batch *batch = arg;
+    batch->root = parse(&batch->tokens, batch->arena);
 }
 
-//S = { statement }
-AST_Node *parse(Token_List *tokens) {
-    //statements
-    AST_Node *statements = NULL, *current_statement = NULL, *new_statement = NULL;
-    while (token_list_current(tokens) != NULL && (new_statement = statement(tokens)) != NULL) {
-        if (statements == NULL) {
-            statements = new_statement;
-            current_statement = new_statement;
+//split [tokens->current, tokens->count) into batches of at least batch_size tokens
+//batches only start at "function" and "if" keywords outside of all braces, which always start a top-level statement
+//return the amount of batches stored in starts (the end of the last batch is tokens->count)
+//0 if the braces are unbalanced (the input is then parsed serially, which reports the error)
+static int find_batches(Token_List *tokens, int batch_size, int *starts) {
+    int batch_count = 1;
+    starts[0] = tokens->current;
+    int depth = 0;
+    for (int i = tokens->current; i < tokens->count; i++) {
+        Token_Type type = tokens->types[i];
+        if (type == TK_OPEN_BRACE) {
+            depth += 1;
+        }
+        else if (type == TK_CLOSE_BRACE) {
+            depth -= 1;
+            if (depth < 0) return 0;
         }
-        else {
-            current_statement->next = new_statement;
-            current_statement = new_statement;
+        else if (depth == 0 && (type == TK_FUNC_KW || type == TK_IF_KW) && i - starts[batch_count - 1] >= batch_size) {
+            starts[batch_count] = i;
+            batch_count += 1;
         }
     }
+    return depth == 0 ? batch_count : 0;
+}
 
-    AST_Node *root = new_ast_node(NULL, ND_ROOT);
-    root->children = statements;
+AST_Node *parse_parallel(Token_List *tokens, Arena *arena, Thread_Pool *pool) {
+    int start = tokens->current;
+    int thread_count = pool == NULL ? 1 : pool->thread_count;
+    int batch_size = (tokens->count - start) / (thread_count * BATCHES_PER_THREAD);
+    if (batch_size < PARALLEL_MIN_BATCH_TOKENS) {
+        batch_size = PARALLEL_MIN_BATCH_TOKENS;
+    }
+    int *starts = malloc(((tokens->count - start) / batch_size + 2) * sizeof(int));
+    int batch_count = thread_count > 1 ? find_batches(tokens, batch_size, starts) : 0;
+    if (batch_count <= 1) {
+        free(starts);
+        return parse(tokens, arena);
+    }
+
+    Parse_Batch *batches = malloc(batch_count * sizeof(Parse_Batch));
+    for (int i = 0; i < batch_count; i++) {
+        Parse_Batch *batch = &batches[i];
+        batch->source = *tokens->source;
+        batch->source.silent = 1;
+        batch->tokens = *tokens;
+        batch->tokens.source = &batch->source;
+        batch->tokens.current = starts[i];
+        batch->tokens.count = i < batch_count - 1 ? starts[i + 1] : tokens->count;
+        batch->arena = new_arena(arena->block_size, arena->flags);
+        thread_pool_submit(pool, parse_batch, batch);
+    }
+    thread_pool_wait(pool);
+
+    int failed = 0;
+    for (int i = 0; i < batch_count; i++) {
+        failed |= batches[i].root == NULL;
+    }
+    AST_Node *root = NULL;
+    if (failed) {
+        //parse again serially, so the first syntax error in source order is reported
+        for (int i = 0; i < batch_count; i++) {
+            free_arena(batches[i].arena);
+        }
+        tokens->current = start;
+        root = parse(tokens, arena);
+    }
+    else {
+        //stitch the statements of all batches together, the nodes stay in the batch arenas (merged into arena)
+        root = new_ast_node(arena, NO_TOKEN, ND_ROOT);
+        for (int i = 0; i < batch_count; i++) {
+            AST_Node *batch_root = batches[i].root;
+            if (batch_root->children != NULL) {
+                if (root->children == NULL) {
+                    root->children = batch_root->children;
+                }
+                else {
+                    root->last_child->next = batch_root->children;
+                }
+                root->last_child = batch_root->last_child;
+                root->child_count += batch_root->child_count;
+            }
+            arena_merge(arena, batches[i].arena);
+        }
+        tokens->current = tokens->count;
+    }
+    free(batches);
+    free(starts);
     return root;
 }
@@ -2,6 +2,7 @@
 #define PARSER_H
 
 #include "lexer.h"
+#include "arena.h"
 
 typedef enum {
     ND_ROOT, ND_FUNCTION_DEF, ND_FUNCTION_CALL, ND_BOOLEAN, ND_COND, ND_COND_TRUE, ND_COND_FALSE, ND_ASSIGN, ND_INT, ND_VAR, ND_ADD, ND_SUB
@@ -9,7 +10,8 @@ typedef enum {
 
 typedef struct AST_Node {
     AST_Node_Type node_type;
-    Token *token;
+    //index into the token list, NO_TOKEN if the node has no token
+    int token;
 
     //binary AST node
     //used for: assignment, boolean, addition, subtraction
@@ -21,7 +23,9 @@ typedef struct AST_Node {
     //n-ary AST node
     //used for: AST root, function definition, true condition, false condition
     //children: when the node itself has children
-    struct AST_Node *children;
+    //last_child and child_count are maintained by ast_node_add_child, so appending is O(1)
+    struct AST_Node *children, *last_child;
+    int child_count;
 
     //next: when the node is part of a list of children
     //important: also use next in binary nodes to make iteration easier (lhs->next == rhs, rhs->next == NULL)
@@ -30,18 +34,17 @@ typedef struct AST_Node {
     //no children needed for: function call, integer, variable
 } AST_Node;
 
-AST_Node *new_ast_node(Token *token, AST_Node_Type type);
-
-void free_ast_node(AST_Node *node);
-
-void free_ast_node_recursive(AST_Node *node);
-
-void free_ast_node_list(AST_Node *node);
-
-void free_ast_node_list_recursive(AST_Node *node);
+//nodes are never freed one by one, they live as long as the arena
+AST_Node *new_ast_node(Arena *arena, int token, AST_Node_Type type);
 
+//append new_child to the children of parent in O(1)
 void ast_node_add_child(AST_Node *parent, AST_Node *new_child);
 
-AST_Node *parse(Token_List *tokens);
+//parse the whole token list, return NULL after reporting a syntax error
+AST_Node *parse(Token_List *tokens, Arena *arena);
+
+//like parse, but split the tokens into batches of top-level statements and parse the batches on the threads of the pool
+//the resulting AST is identical to the one of parse (small inputs are parsed serially)
+AST_Node *parse_parallel(Token_List *tokens, Arena *arena, Thread_Pool *pool);
 
 #endif
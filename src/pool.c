@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include "pool.h"
+
+//worker the current thread belongs to, NULL outside of all pools
+static __thread Pool_Worker *current_worker = NULL;
+
+static void queue_push(Pool_Queue *queue, Pool_Task *task) {
+    pthread_mutex_lock(&queue->lock);
+    task->previous = queue->last;
+    task->next = NULL;
+    if (queue->last == NULL) {
+        queue->first = task;
+    }
+    else {
+        queue->last->next = task;
+    }
+    queue->last = task;
+    pthread_mutex_unlock(&queue->lock);
+}
+
+//newest task, used by the owner of the queue
+static Pool_Task *queue_pop_last(Pool_Queue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    Pool_Task *task = queue->last;
+    if (task != NULL) {
+        queue->last = task->previous;
+        if (queue->last == NULL) {
+            queue->first = NULL;
+        }
+        else {
+            queue->last->next = NULL;
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return task;
+}
+
+//oldest task, used by thieves
+static Pool_Task *queue_pop_first(Pool_Queue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    Pool_Task *task = queue->first;
+    if (task != NULL) {
+        queue->first = task->next;
+        if (queue->first == NULL) {
+            queue->last = NULL;
+        }
+        else {
+            queue->first->previous = NULL;
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return task;
+}
+
+//own queue first, then steal from the other workers
+static Pool_Task *find_task(Thread_Pool *pool, int index) {
+    Pool_Task *task = queue_pop_last(&pool->queues[index]);
+    for (int i = 1; task == NULL && i < pool->thread_count; i++) {
+        task = queue_pop_first(&pool->queues[(index + i) % pool->thread_count]);
+    }
+    return task;
+}
+
+static void *worker(void *arg) {
+    Pool_Worker *self = arg;
+    Thread_Pool *pool = self->pool;
+    current_worker = self;
+    while (1) {
+        Pool_Task *task = find_task(pool, self->index);
+        if (task == NULL) {
+            pthread_mutex_lock(&pool->lock);
+            while (pool->queued == 0 && !pool->shutdown) {
+                pthread_cond_wait(&pool->task_available, &pool->lock);
+            }
+            int done = pool->queued == 0;
+            pthread_mutex_unlock(&pool->lock);
+            if (done) {
+                //shutdown and no work left
+                break;
+            }
+            continue;
+        }
+        pthread_mutex_lock(&pool->lock);
+        pool->queued -= 1;
+        pthread_mutex_unlock(&pool->lock);
+
+        task->function(task->arg);
+        free(task);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->pending -= 1;
+        if (pool->pending == 0) {
+            pthread_cond_broadcast(&pool->all_done);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    current_worker = NULL;
+    return NULL;
+}
+
+Thread_Pool *new_thread_pool(int thread_count) {
+    Thread_Pool *pool = malloc(sizeof(Thread_Pool));
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+    pool->thread_count = thread_count;
+    pool->next_queue = 0;
+    pool->queued = 0;
+    pool->pending = 0;
+    pool->shutdown = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->task_available, NULL);
+    pthread_cond_init(&pool->all_done, NULL);
+    pool->queues = malloc(thread_count * sizeof(Pool_Queue));
+    pool->workers = malloc(thread_count * sizeof(Pool_Worker));
+    pool->threads = malloc(thread_count * sizeof(pthread_t));
+    for (int i = 0; i < thread_count; i++) {
+        pthread_mutex_init(&pool->queues[i].lock, NULL);
+        pool->queues[i].first = NULL;
+        pool->queues[i].last = NULL;
+        pool->workers[i] = (Pool_Worker) { pool, i };
+    }
+    for (int i = 0; i < thread_count; i++) {
+        pthread_create(&pool->threads[i], NULL, worker, &pool->workers[i]);
+    }
+    return pool;
+}
+
+void free_thread_pool(Thread_Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->task_available);
+    pthread_mutex_unlock(&pool->lock);
+    //workers that are still running may try to steal from any queue, so only destroy the queues after all of them stopped
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->task_available);
+    pthread_cond_destroy(&pool->all_done);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool->queues);
+    free(pool);
+}
+
+void thread_pool_submit(Thread_Pool *pool, Pool_Function *function, void *arg) {
+    Pool_Task *task = malloc(sizeof(Pool_Task));
+    task->function = function;
+    task->arg = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    int index;
+    if (current_worker != NULL && current_worker->pool == pool) {
+        index = current_worker->index;
+    }
+    else {
+        index = pool->next_queue;
+        pool->next_queue = (pool->next_queue + 1) % pool->thread_count;
+    }
+    //queue before counting, so a worker that sees queued > 0 is guaranteed to find the task (or a thief got it)
+    queue_push(&pool->queues[index], task);
+    pool->queued += 1;
+    pool->pending += 1;
+    pthread_cond_signal(&pool->task_available);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_wait(Thread_Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->all_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
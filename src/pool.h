@@ -0,0 +1,60 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+
+//fixed size work stealing thread pool used to run independent parts of a compiler step in parallel
+//every worker has its own task queue, idle workers steal the oldest task of another worker
+
+typedef void Pool_Function(void *arg);
+
+typedef struct Pool_Task {
+    Pool_Function *function;
+    void *arg;
+    struct Pool_Task *previous, *next;
+} Pool_Task;
+
+//double ended queue of one worker, the worker takes the newest task (last), thieves take the oldest (first)
+typedef struct {
+    pthread_mutex_t lock;
+    Pool_Task *first, *last;
+} Pool_Queue;
+
+typedef struct Thread_Pool Thread_Pool;
+
+typedef struct {
+    Thread_Pool *pool;
+    int index;
+} Pool_Worker;
+
+struct Thread_Pool {
+    pthread_t *threads;
+    Pool_Worker *workers;
+    Pool_Queue *queues;
+    int thread_count;
+    //queue that receives the next task submitted from outside of the pool (round robin)
+    int next_queue;
+    //protects the counters below, idle workers sleep on task_available
+    pthread_mutex_t lock;
+    pthread_cond_t task_available, all_done;
+    //tasks that have not been started yet
+    int queued;
+    //queued and running tasks
+    int pending;
+    int shutdown;
+};
+
+Thread_Pool *new_thread_pool(int thread_count);
+
+//wait for all tasks and stop the worker threads
+void free_thread_pool(Thread_Pool *pool);
+
+//run function(arg) on one of the worker threads
+//tasks submitted by a running task are queued on the same worker
+void thread_pool_submit(Thread_Pool *pool, Pool_Function *function, void *arg);
+
+//block until all submitted tasks are done
+//important: must not be called from a task
+void thread_pool_wait(Thread_Pool *pool);
+
+#endif
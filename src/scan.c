@@ -0,0 +1,290 @@
+#include <stddef.h>
+#include "scan.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+//scalar kernels (fallback and tails of the vector kernels)
+
+static long scalar_whitespace(const char *text, long size) {
+    long i = 0;
+    while (i < size && (text[i] == ' ' || text[i] == '\n')) {
+        i += 1;
+    }
+    return i;
+}
+
+static long scalar_char(const char *text, long size, char c) {
+    long i = 0;
+    while (i < size && text[i] != c) {
+        i += 1;
+    }
+    return i;
+}
+
+static long scalar_block_comment_end(const char *text, long size) {
+    for (long i = 0; i + 1 < size; i++) {
+        if (text[i] == '*' && text[i + 1] == '/') {
+            return i;
+        }
+    }
+    return size;
+}
+
+static long scalar_count_char(const char *text, long size, char c) {
+    long count = 0;
+    for (long i = 0; i < size; i++) {
+        count += text[i] == c;
+    }
+    return count;
+}
+
+static long scalar_line_starts(const char *text, long size, long *line_starts) {
+    long count = 0;
+    for (long i = 0; i < size; i++) {
+        if (text[i] == '\n') {
+            line_starts[count] = i + 1;
+            count += 1;
+        }
+    }
+    return count;
+}
+
+#ifdef SCAN_X86
+
+//sse2 kernels (always available on x86-64)
+//each iteration compares 16 bytes and turns the result into a bit mask (one bit per byte)
+
+static long sse2_whitespace(const char *text, long size) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    long i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (text + i));
+        __m128i is_whitespace = _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, newline));
+        unsigned mask = ~_mm_movemask_epi8(is_whitespace) & 0xffff;
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + scalar_whitespace(text + i, size - i);
+}
+
+static long sse2_char(const char *text, long size, char c) {
+    const __m128i pattern = _mm_set1_epi8(c);
+    long i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (text + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + scalar_char(text + i, size - i, c);
+}
+
+static long sse2_block_comment_end(const char *text, long size) {
+    const __m128i star = _mm_set1_epi8('*');
+    const __m128i slash = _mm_set1_epi8('/');
+    long i = 0;
+    //compare a chunk with '*' and the same chunk shifted by one byte with '/'
+    for (; i + 17 <= size; i += 16) {
+        __m128i first = _mm_loadu_si128((const __m128i *) (text + i));
+        __m128i second = _mm_loadu_si128((const __m128i *) (text + i + 1));
+        __m128i is_end = _mm_and_si128(_mm_cmpeq_epi8(first, star), _mm_cmpeq_epi8(second, slash));
+        unsigned mask = _mm_movemask_epi8(is_end);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + scalar_block_comment_end(text + i, size - i);
+}
+
+static long sse2_count_char(const char *text, long size, char c) {
+    const __m128i pattern = _mm_set1_epi8(c);
+    long count = 0;
+    long i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (text + i));
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern)));
+    }
+    return count + scalar_count_char(text + i, size - i, c);
+}
+
+static long sse2_line_starts(const char *text, long size, long *line_starts) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    long count = 0;
+    long i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (text + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        //one entry per set bit
+        while (mask != 0) {
+            line_starts[count] = i + __builtin_ctz(mask) + 1;
+            count += 1;
+            mask &= mask - 1;
+        }
+    }
+    long tail_count = scalar_line_starts(text + i, size - i, line_starts + count);
+    for (long j = count; j < count + tail_count; j++) {
+        line_starts[j] += i;
+    }
+    return count + tail_count;
+}
+
+//avx2 kernels, same as the sse2 kernels but with 32 bytes per iteration
+
+__attribute__((target("avx2")))
+static long avx2_whitespace(const char *text, long size) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    long i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (text + i));
+        __m256i is_whitespace = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, newline));
+        unsigned mask = ~(unsigned) _mm256_movemask_epi8(is_whitespace);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + sse2_whitespace(text + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static long avx2_char(const char *text, long size, char c) {
+    const __m256i pattern = _mm256_set1_epi8(c);
+    long i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (text + i));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, pattern));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + sse2_char(text + i, size - i, c);
+}
+
+__attribute__((target("avx2")))
+static long avx2_block_comment_end(const char *text, long size) {
+    const __m256i star = _mm256_set1_epi8('*');
+    const __m256i slash = _mm256_set1_epi8('/');
+    long i = 0;
+    for (; i + 33 <= size; i += 32) {
+        __m256i first = _mm256_loadu_si256((const __m256i *) (text + i));
+        __m256i second = _mm256_loadu_si256((const __m256i *) (text + i + 1));
+        __m256i is_end = _mm256_and_si256(_mm256_cmpeq_epi8(first, star), _mm256_cmpeq_epi8(second, slash));
+        unsigned mask = _mm256_movemask_epi8(is_end);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + sse2_block_comment_end(text + i, size - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+static long avx2_count_char(const char *text, long size, char c) {
+    const __m256i pattern = _mm256_set1_epi8(c);
+    long count = 0;
+    long i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (text + i));
+        count += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, pattern)));
+    }
+    return count + sse2_count_char(text + i, size - i, c);
+}
+
+__attribute__((target("avx2")))
+static long avx2_line_starts(const char *text, long size, long *line_starts) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    long count = 0;
+    long i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (text + i));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+        while (mask != 0) {
+            line_starts[count] = i + __builtin_ctz(mask) + 1;
+            count += 1;
+            mask &= mask - 1;
+        }
+    }
+    long tail_count = sse2_line_starts(text + i, size - i, line_starts + count);
+    for (long j = count; j < count + tail_count; j++) {
+        line_starts[j] += i;
+    }
+    return count + tail_count;
+}
+
+#endif
+
+//runtime dispatch
+
+typedef struct {
+    Scan_Kernels kernels;
+    long (*whitespace)(const char *text, long size);
+    long (*find_char)(const char *text, long size, char c);
+    long (*block_comment_end)(const char *text, long size);
+    long (*count_char)(const char *text, long size, char c);
+    long (*line_starts)(const char *text, long size, long *line_starts);
+} Scan_Dispatch;
+
+static Scan_Dispatch dispatch = { 0 };
+
+Scan_Kernels scan_detect() {
+#ifdef SCAN_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return SCAN_AVX2;
+    }
+    return SCAN_SSE2;
+#else
+    return SCAN_SCALAR;
+#endif
+}
+
+void scan_select(Scan_Kernels kernels) {
+#ifdef SCAN_X86
+    if (kernels == SCAN_AVX2 && __builtin_cpu_supports("avx2")) {
+        dispatch = (Scan_Dispatch) { SCAN_AVX2, avx2_whitespace, avx2_char, avx2_block_comment_end, avx2_count_char, avx2_line_starts };
+        return;
+    }
+    if (kernels != SCAN_SCALAR) {
+        dispatch = (Scan_Dispatch) { SCAN_SSE2, sse2_whitespace, sse2_char, sse2_block_comment_end, sse2_count_char, sse2_line_starts };
+        return;
+    }
+#endif
+    dispatch = (Scan_Dispatch) { SCAN_SCALAR, scalar_whitespace, scalar_char, scalar_block_comment_end, scalar_count_char, scalar_line_starts };
+}
+
+//select the best kernels before main, so concurrent compilations never race on the first use of a kernel
+__attribute__((constructor)) static void scan_init() {
+#ifdef SCAN_X86
+    //required before __builtin_cpu_supports in code that runs before main
+    __builtin_cpu_init();
+#endif
+    scan_select(scan_detect());
+}
+
+Scan_Kernels scan_selected() {
+    return dispatch.kernels;
+}
+
+long scan_whitespace(const char *text, long size) {
+    return dispatch.whitespace(text, size);
+}
+
+long scan_char(const char *text, long size, char c) {
+    return dispatch.find_char(text, size, c);
+}
+
+long scan_block_comment_end(const char *text, long size) {
+    return dispatch.block_comment_end(text, size);
+}
+
+long scan_count_char(const char *text, long size, char c) {
+    return dispatch.count_char(text, size, c);
+}
+
+long scan_line_starts(const char *text, long size, long *line_starts) {
+    return dispatch.line_starts(text, size, line_starts);
+}
@@ -0,0 +1,37 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+//vectorized kernels used by the lexer to skip whitespace and comments
+//all kernels are bounded by size and never read past text + size (text does not need to be null terminated)
+
+typedef enum {
+    SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2,
+} Scan_Kernels;
+
+//best kernels supported by the cpu
+Scan_Kernels scan_detect();
+
+//select the kernels used by all scan functions
+//by default the result of scan_detect() is selected at startup
+//important: not thread safe, only call it while no other thread is lexing
+void scan_select(Scan_Kernels kernels);
+
+Scan_Kernels scan_selected();
+
+//amount of whitespace characters (' ', '\n') at the start of text
+long scan_whitespace(const char *text, long size);
+
+//index of the first occurence of c, size if there is none
+long scan_char(const char *text, long size, char c);
+
+//index of the first "*/", size if there is none
+long scan_block_comment_end(const char *text, long size);
+
+//amount of occurences of c
+long scan_count_char(const char *text, long size, char c);
+
+//store the offset after every newline in line_starts (needs room for scan_count_char(text, size, '\n') entries)
+//and return the amount of stored offsets
+long scan_line_starts(const char *text, long size, long *line_starts);
+
+#endif
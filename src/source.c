@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "source.h"
+#include "scan.h"
+
+Source *new_source(const char *text, long size) {
+    Source *source = malloc(sizeof(Source));
+    source->text = text;
+    source->size = size;
+    source->storage = SOURCE_BORROWED;
+    source->silent = 0;
+    source->line_starts = NULL;
+    source->line_count = 0;
+    return source;
+}
+
+#define STREAM_BUFFER_MIN_SIZE (64 * 1024)
+
+//read everything from fd into a growable buffer (for pipes and other inputs that cannot be mapped)
+static Source *read_stream(int fd) {
+    long capacity = STREAM_BUFFER_MIN_SIZE, size = 0;
+    char *text = malloc(capacity);
+    while (1) {
+        if (size == capacity) {
+            capacity *= 2;
+            text = realloc(text, capacity);
+        }
+        ssize_t read_size = read(fd, text + size, capacity - size);
+        if (read_size == 0) {
+            break;
+        }
+        if (read_size == -1) {
+            free(text);
+            return NULL;
+        }
+        size += read_size;
+    }
+    Source *source = new_source(text, size);
+    source->storage = SOURCE_OWNED;
+    return source;
+}
+
+Source *read_source(const char *path) {
+    if (strcmp(path, "-") == 0) {
+        Source *source = read_stream(STDIN_FILENO);
+        if (source == NULL) {
+            printf("ERROR: could not read stdin!\n");
+        }
+        return source;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        printf("ERROR: could not open %s!\n", path);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        printf("ERROR: could not read %s!\n", path);
+        close(fd);
+        return NULL;
+    }
+    Source *source;
+    if (!S_ISREG(st.st_mode)) {
+        source = read_stream(fd);
+    }
+    else if (st.st_size == 0) {
+        //mapping an empty file fails
+        source = new_source("", 0);
+    }
+    else {
+        void *text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (text == MAP_FAILED) {
+            source = NULL;
+        }
+        else {
+            //the lexer reads the text once front to back
+            madvise(text, st.st_size, MADV_SEQUENTIAL);
+            source = new_source(text, st.st_size);
+            source->storage = SOURCE_MAPPED;
+        }
+    }
+    close(fd);
+    if (source == NULL) {
+        printf("ERROR: could not read %s!\n", path);
+    }
+    return source;
+}
+
+void free_source(Source *source) {
+    if (source->storage == SOURCE_MAPPED) {
+        munmap((void *) source->text, source->size);
+    }
+    else if (source->storage == SOURCE_OWNED) {
+        free((void *) source->text);
+    }
+    free(source->line_starts);
+    free(source);
+}
+
+void source_index_lines(Source *source) {
+    if (source->line_starts != NULL) {
+        return;
+    }
+    long newlines = scan_count_char(source->text, source->size, '\n');
+    source->line_starts = malloc((newlines + 1) * sizeof(long));
+    source->line_starts[0] = 0;
+    source->line_count = 1 + scan_line_starts(source->text, source->size, source->line_starts + 1);
+}
+
+void source_position(Source *source, long pos, long *line, long *column) {
+    source_index_lines(source);
+    //last line that starts at or before pos
+    long low = 0, high = source->line_count - 1;
+    while (low < high) {
+        long middle = low + (high - low + 1) / 2;
+        if (source->line_starts[middle] <= pos) {
+            low = middle;
+        }
+        else {
+            high = middle - 1;
+        }
+    }
+    *line = low + 1;
+    *column = pos - source->line_starts[low] + 1;
+}
+
+int source_error(Source *source, long pos, char *fmt, ...) {
+    if (source->silent) {
+        return 1;
+    }
+    long line, column;
+    source_position(source, pos, &line, &column);
+    printf("ERROR:%ld:%ld: ", line, column);
+    va_list fmt_args;
+    va_start(fmt_args, fmt);
+    vprintf(fmt, fmt_args);
+    va_end(fmt_args);
+    printf("\n");
+    return 1;
+}
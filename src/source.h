@@ -0,0 +1,41 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+//who is responsible for releasing the text of a source
+typedef enum {
+    SOURCE_BORROWED, SOURCE_OWNED, SOURCE_MAPPED,
+} Source_Storage;
+
+//immutable input buffer, kept alive for the whole compilation
+//tokens only store views (offset, length) into it, so the text does not need to be null terminated
+typedef struct {
+    const char *text;
+    long size;
+    Source_Storage storage;
+    //suppress all diagnostics (used for speculative work that is redone serially if it fails)
+    int silent;
+    //offset of the first character of every line, built on first use by source_position
+    long *line_starts;
+    long line_count;
+} Source;
+
+//borrow text, the caller keeps ownership
+Source *new_source(const char *text, long size);
+
+//map the file at path read-only, "-" reads stdin into a growable buffer instead
+//return NULL (after printing an error) if the input cannot be read
+Source *read_source(const char *path);
+
+void free_source(Source *source);
+
+//build the line index up front
+//important: call before looking up positions from multiple threads
+void source_index_lines(Source *source);
+
+//line and column (both starting at 1) of the character at offset pos, O(log(lines))
+void source_position(Source *source, long pos, long *line, long *column);
+
+//print "ERROR:line:column: " followed by the formatted message (unless the source is silent) and return 1
+int source_error(Source *source, long pos, char *fmt, ...);
+
+#endif
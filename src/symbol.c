@@ -1,50 +1,29 @@
 #include <stdlib.h>
+#include <limits.h>
 #include "symbol.h"
 #include "lexer.h"
 
 //collections
 
-Collection_Container *new_collection_container(void *item) {
-    Collection_Container *new = malloc(sizeof(Collection_Container));
+Collection_Container *new_collection_container(Arena *arena, void *item) {
+    Collection_Container *new = arena_alloc(arena, sizeof(Collection_Container));
     new->item = item;
     new->next = NULL;
     return new;
 }
 
-void free_collection_container(Collection_Container *container) {
-    free(container);
-}
-
 //list
 
-List *new_list() {
-    List *new = malloc(sizeof(List));
+List *new_list(Arena *arena) {
+    List *new = arena_alloc(arena, sizeof(List));
     new->root = NULL;
     new->current = NULL;
+    new->arena = arena;
     return new;
 }
 
-void free_list(List *list) {
-    Collection_Container *current = list->root;
-    while (current != NULL) {
-        free_collection_container(current);
-        current = current->next;
-    }
-    free(list);
-}
-
-void deep_free_list(List *list, void (*free_item)()) {
-    Collection_Container *current = list->root;
-    while (current != NULL) {
-        (*free_item)(current->item);
-        free_collection_container(current);
-        current = current->next;
-    }
-    free(list);
-}
-
 void list_add(List *list, void *item) {
-    Collection_Container *container = new_collection_container(item);
+    Collection_Container *container = new_collection_container(list->arena, item);
     if (list->root == NULL) {
         list->root = container;
     }
@@ -54,167 +33,254 @@ void list_add(List *list, void *item) {
     list->current = container;
 }
 
-//stack
+//symbol table
 
-Stack *new_stack() {
-    Stack *new = malloc(sizeof(Stack));
-    new->top = NULL;
+Symbol *new_symbol(Arena *arena, Symbol_Type type, int name) {
+    Symbol *new = arena_alloc(arena, sizeof(Symbol));
+    new->type = type;
+    new->name = name;
+    new->id = NO_IDENT;
+    new->addr = 0;
+    new->mangle_index = 0;
+    new->scope = NO_SCOPE;
     return new;
 }
 
-void free_stack(Stack *stack) {
-    Collection_Container *current = stack->top;
-    while (current != NULL) {
-        free_collection_container(current);
-        current = current->next;
-    }
-    free(stack);
+//scope without symbols or children
+static void init_scope(Scope *scope, Arena *arena, int id, int parent) {
+    scope->id = id;
+    scope->symbols = new_list(arena);
+    //most scopes stay empty or small, slots are allocated with the first symbol
+    scope->slots = NULL;
+    scope->slot_count = 0;
+    scope->symbol_count = 0;
+    scope->parent = parent;
+    scope->first_child = NO_SCOPE;
+    scope->last_child = NO_SCOPE;
+    scope->next_sibling = NO_SCOPE;
+    scope->child_count = 0;
+    scope->arena = arena;
 }
 
-void stack_push(Stack *stack, void *item) {
-    Collection_Container *container = new_collection_container(item);
-    container->next = stack->top;
-    stack->top = container;
+//first slot to probe for id (fibonacci hashing, slot_count is a power of 2)
+static unsigned int scope_slot(Scope *scope, int id) {
+    return ((unsigned int) id * 2654435769u) & (scope->slot_count - 1);
 }
 
-void *stack_pop(Stack *stack) {
-    Collection_Container *container = stack->top;
-    if (container == NULL) {
-        return NULL;
+static Symbol **scope_alloc_slots(Arena *arena, int slot_count) {
+    Symbol **slots = arena_alloc(arena, slot_count * sizeof(Symbol *));
+    for (int i = 0; i < slot_count; i++) {
+        slots[i] = NULL;
     }
-    stack->top = container->next;
-    void *item = container->item;
-    free_collection_container(container);
-    return item;
+    return slots;
 }
 
-void *stack_get(Stack *stack) {
-    if (stack == NULL || stack->top == NULL) {
-        return NULL;
+//double the amount of slots and reinsert all symbols
+//the old slots stay in the arena, which at most doubles the memory of the map
+static void scope_grow(Scope *scope) {
+    Symbol **old_slots = scope->slots;
+    int old_slot_count = scope->slot_count;
+    scope->slot_count = old_slot_count == 0 ? SCOPE_INITIAL_SLOTS : old_slot_count * 2;
+    scope->slots = scope_alloc_slots(scope->arena, scope->slot_count);
+    for (int i = 0; i < old_slot_count; i++) {
+        if (old_slots[i] != NULL) {
+            unsigned int slot = scope_slot(scope, old_slots[i]->id);
+            while (scope->slots[slot] != NULL) {
+                slot = (slot + 1) & (scope->slot_count - 1);
+            }
+            scope->slots[slot] = old_slots[i];
+        }
     }
-    return stack->top->item;
 }
 
-//symbol table
+void scope_add_symbol(Scope *scope, Symbol *symbol) {
+    if ((scope->symbol_count + 1) * 4 > scope->slot_count * 3) {
+        scope_grow(scope);
+    }
+    unsigned int slot = scope_slot(scope, symbol->id);
+    while (scope->slots[slot] != NULL && scope->slots[slot]->id != symbol->id) {
+        slot = (slot + 1) & (scope->slot_count - 1);
+    }
+    //on redefinition in the same scope lookups keep returning the first definition
+    if (scope->slots[slot] == NULL) {
+        scope->slots[slot] = symbol;
+        scope->symbol_count += 1;
+    }
+    list_add(scope->symbols, symbol);
+    symbol->scope = scope->id;
+}
 
-Symbol *new_symbol(Symbol_Type type, Token *name) {
-    Symbol *new = malloc(sizeof(Symbol));
-    new->type = type;
-    new->name = name;
-    new->addr = 0;
-    new->initialized = 0;
-    new->mangle_index = 0;
-    return new;
+Symbol *scope_get_symbol(Scope *scope, int id) {
+    if (scope->slot_count == 0) {
+        return NULL;
+    }
+    unsigned int slot = scope_slot(scope, id);
+    while (scope->slots[slot] != NULL) {
+        if (scope->slots[slot]->id == id) {
+            return scope->slots[slot];
+        }
+        slot = (slot + 1) & (scope->slot_count - 1);
+    }
+    return NULL;
 }
 
-void free_symbol(Symbol *symbol) {
-    free(symbol);
+void symbol_table_reserve_scopes(Symbol_Table *table, int count) {
+    if (count <= table->scope_capacity) {
+        return;
+    }
+    //like the slots of a scope, the old array stays in the arena
+    Scope *scopes = arena_alloc(table->arena, count * sizeof(Scope));
+    for (int i = 0; i < table->scope_count; i++) {
+        scopes[i] = table->scopes[i];
+    }
+    table->scopes = scopes;
+    table->scope_capacity = count;
 }
 
-Scope *new_scope() {
-    Scope *new = malloc(sizeof(Scope));
-    new->symbols = new_list();
-    new->scopes = new_list();
-    return new;
+//append a new scope with parent to the scope array and return its id
+static int symbol_table_add_scope(Symbol_Table *table, int parent) {
+    if (table->scope_count == table->scope_capacity) {
+        symbol_table_reserve_scopes(table, table->scope_capacity == 0 ? 16 : table->scope_capacity * 2);
+    }
+    int id = table->scope_count;
+    table->scope_count += 1;
+    init_scope(&table->scopes[id], table->arena, id, parent);
+    if (parent != NO_SCOPE) {
+        Scope *parent_scope = &table->scopes[parent];
+        if (parent_scope->last_child == NO_SCOPE) {
+            parent_scope->first_child = id;
+        }
+        else {
+            table->scopes[parent_scope->last_child].next_sibling = id;
+        }
+        parent_scope->last_child = id;
+        parent_scope->child_count += 1;
+    }
+    return id;
 }
 
-void free_scope(Scope *scope) {
-    deep_free_list(scope->symbols, &free_symbol);
-    deep_free_list(scope->scopes, &free_scope);
-    free(scope);
+Symbol_Table *new_symbol_table(Token_List *tokens, Arena *arena) {
+    Symbol_Table *new = arena_alloc(arena, sizeof(Symbol_Table));
+    new->tokens = tokens;
+    new->arena = arena;
+    new->scopes = NULL;
+    new->scope_count = 0;
+    new->scope_capacity = 0;
+    new->current = symbol_table_add_scope(new, NO_SCOPE);
+    new->resolved = NULL;
+    new->resolved_count = 0;
+    new->visible_end = INT_MAX;
+    new->lookups = 0;
+    return new;
 }
 
-void scope_add_symbol(Scope *scope, Symbol *symbol) {
-    list_add(scope->symbols, symbol);
+void symbol_table_clear(Symbol_Table *table) {
+    table->scope_count = 0;
+    table->current = symbol_table_add_scope(table, NO_SCOPE);
+    table->resolved = NULL;
+    table->resolved_count = 0;
+    table->visible_end = INT_MAX;
 }
 
-void scope_add_scope(Scope *scope, Scope *add_scope) {
-    list_add(scope->scopes, add_scope);
+void symbol_table_skip_scopes(Symbol_Table *table, int count) {
+    symbol_table_reserve_scopes(table, table->scope_count + count);
+    table->scope_count += count;
 }
 
-Symbol_Table *new_symbol_table() {
-    Symbol_Table *new = malloc(sizeof(Symbol_Table));
-    Scope *root_scope = new_scope();
-    new->root_scope = root_scope;
-    new->current = new_stack();
-    stack_push(new->current, root_scope);
-    return new;
+Symbol_Table *symbol_table_view(Symbol_Table *table, Token_List *tokens, Arena *arena) {
+    Symbol_Table *view = arena_alloc(arena, sizeof(Symbol_Table));
+    *view = *table;
+    view->tokens = tokens;
+    view->arena = arena;
+    view->lookups = 0;
+    return view;
 }
 
-void free_symbol_table(Symbol_Table *table) {
-    free_stack(table->current);
-    free_scope(table->root_scope);
-    free(table);
+void symbol_table_enter_reserved(Symbol_Table *view, int scope, int visible_end) {
+    Scope *entered = &view->scopes[scope];
+    entered->arena = view->arena;
+    entered->symbols->arena = view->arena;
+    view->current = scope;
+    view->scope_count = scope + 1;
+    view->visible_end = visible_end;
 }
 
 void symbol_table_push(Symbol_Table *table) {
-    Scope *scope = new_scope();
-    Scope *current_scope = stack_get(table->current);
-    list_add(current_scope->scopes, scope);
-    stack_push(table->current, scope);
+    table->current = symbol_table_add_scope(table, table->current);
 }
 
 void symbol_table_pop(Symbol_Table *table) {
-    if (stack_pop(table->current) == NULL) {
-        stack_push(table->current, table->root_scope);
+    int parent = table->scopes[table->current].parent;
+    if (parent != NO_SCOPE) {
+        table->current = parent;
     }
 }
 
+void symbol_table_enter(Symbol_Table *table, int scope) {
+    table->current = scope;
+}
+
 void symbol_table_reset_current(Symbol_Table *table) {
-    while (table->current->top->next != NULL) {
-        stack_pop(table->current);
-    }
+    table->current = ROOT_SCOPE;
 }
 
 void symbol_table_walk_child(Symbol_Table *table) {
-    Scope *current_scope = table->current->top->item;
-    stack_push(table->current, current_scope->scopes->root->item);
+    table->current = table->scopes[table->current].first_child;
 }
 
 void symbol_table_walk_next(Symbol_Table *table) {
-    Scope *orig_scope = table->current->top->item;
-    if (orig_scope != table->root_scope) {
-        symbol_table_pop(table);
-        Scope *current_scope = table->current->top->item;
-        Collection_Container *current_scope_cont = current_scope->scopes->root;
-        while (current_scope_cont != NULL && current_scope_cont->item != orig_scope) {
-            current_scope_cont = current_scope_cont->next;
-        }
-        stack_push(table->current, current_scope_cont->next->item);
+    if (table->current != ROOT_SCOPE) {
+        table->current = table->scopes[table->current].next_sibling;
     }
 }
 
 void symbol_table_set(Symbol_Table *table, Symbol *symbol) {
-    Scope *current_scope = stack_get(table->current);
-    list_add(current_scope->symbols, symbol);
-}
-
-Symbol *symbol_table_get(Symbol_Table *table, Token *name) {
-    Collection_Container *current_scope_cont = table->current->top;
-    while (current_scope_cont != NULL) {
-        Scope *current_scope = current_scope_cont->item;
-        Collection_Container *current_sym_cont = current_scope->symbols->root;
-        while (current_sym_cont != NULL) {
-            Symbol *current_symbol = current_sym_cont->item;
-            if (token_equals(current_symbol->name, name)) {
-                return current_symbol;
-            }
-            current_sym_cont = current_sym_cont->next;
+    symbol->id = token_id(table->tokens, symbol->name);
+    scope_add_symbol(&table->scopes[table->current], symbol);
+}
+
+Symbol *symbol_table_get(Symbol_Table *table, int name) {
+    table->lookups += 1;
+    int id = token_id(table->tokens, name);
+    int scope = table->current;
+    while (scope != NO_SCOPE) {
+        Symbol *symbol = scope_get_symbol(&table->scopes[scope], id);
+        if (symbol != NULL && (scope != ROOT_SCOPE || symbol->name < table->visible_end)) {
+            return symbol;
         }
-        current_scope_cont = current_scope_cont->next;
+        scope = table->scopes[scope].parent;
     }
     return NULL;
 }
 
-Symbol *symbol_table_is_local(Symbol_Table *table, Token *name) {
-    Scope *current_scope = table->current->top->item;
-    Collection_Container *current_sym_cont = current_scope->symbols->root;
-    while (current_sym_cont != NULL) {
-        Symbol *current_symbol = current_sym_cont->item;
-        if (token_equals(current_symbol->name, name)) {
-            return current_symbol;
-        }
-        current_sym_cont = current_sym_cont->next;
+Symbol *symbol_table_is_local(Symbol_Table *table, int name) {
+    table->lookups += 1;
+    return scope_get_symbol(&table->scopes[table->current], token_id(table->tokens, name));
+}
+
+void symbol_table_init_resolved(Symbol_Table *table, int node_count) {
+    table->resolved = arena_alloc(table->arena, node_count * sizeof(Resolution));
+    table->resolved_count = node_count;
+    for (int i = 0; i < node_count; i++) {
+        table->resolved[i].symbol = NULL;
+        table->resolved[i].scope = NO_SCOPE;
     }
-    return NULL;
+}
+
+void symbol_table_resolve(Symbol_Table *table, int node, Symbol *symbol) {
+    table->resolved[node].symbol = symbol;
+    table->resolved[node].scope = table->current;
+}
+
+Symbol *resolved_symbol(Symbol_Table *table, int node) {
+    return table->resolved[node].symbol;
+}
+
+int resolved_scope(Symbol_Table *table, int node) {
+    return table->resolved[node].scope;
+}
+
+int resolved_is_local(Symbol_Table *table, int node) {
+    Resolution *resolution = &table->resolved[node];
+    return resolution->symbol != NULL && resolution->symbol->scope == resolution->scope;
 }
@@ -2,100 +2,143 @@
 #define SYMBOL_H
 
 #include "lexer.h"
+#include "arena.h"
 
 //universal collections used in symbol table
+//all collections allocate their containers from the arena they were created with
 
 typedef struct Collection_Container {
     struct Collection_Container *next;
     void *item;
 } Collection_Container;
 
-Collection_Container *new_collection_container(void *item);
-
-void free_collection_container(Collection_Container *container);
+Collection_Container *new_collection_container(Arena *arena, void *item);
 
 //universal list
 
 typedef struct {
     Collection_Container *root, *current;
+    Arena *arena;
 } List;
 
-List *new_list();
-
-//only free list itself, not contents
-void free_list(List *list);
-
-//free list and contents aswell
-void deep_free_list(List *list, void (*free_item)());
+List *new_list(Arena *arena);
 
 void list_add(List *list, void *item);
 
-//universal stack
-
-typedef struct {
-    Collection_Container *top;
-} Stack;
-
-Stack *new_stack();
-
-//only free stack itself, not contents
-void free_stack(Stack *stack);
-
-void stack_push(Stack *stack, void *item);
-
-void *stack_pop(Stack *stack);
-
-void *stack_get(Stack *stack);
-
 //symbol table
 
 typedef enum {
     SYM_INT, SYM_FUNC,
 } Symbol_Type;
 
+//no scope, e.g. the parent of the root scope
+#define NO_SCOPE -1
+//the root scope is always the first scope of a table
+#define ROOT_SCOPE 0
+
 typedef struct Symbol {
     Symbol_Type type;
-    Token *name;
+    //token index of the name
+    int name;
+    //interned id of the name, set when the symbol is added to the table
+    int id;
     int addr;
-    char initialized;
     int mangle_index;
+    //id of the scope the symbol is defined in, set when the symbol is added to a scope
+    int scope;
 } Symbol;
 
 //TODO no need to have 'public' headers
 
-Symbol *new_symbol(Symbol_Type type, Token *name);
+Symbol *new_symbol(Arena *arena, Symbol_Type type, int name);
 
-void free_symbol(Symbol *symbol);
+//initial amount of slots of a scope's symbol map, always a power of 2
+#define SCOPE_INITIAL_SLOTS 8
 
+//scopes are stored in a single array per table and refer to each other by their index (id) in it
+//ids are handed out in order of creation, which is the pre-order of the AST, so a parent always comes before its children
 typedef struct Scope {
-    List *symbols, *scopes;
+    int id;
+    //symbols in order of definition (used to assign addresses)
+    List *symbols;
+    //open addressing hash map (linear probing) from interned id to symbol, NULL marks an empty slot
+    //grows at 3/4 load, so lookups do not depend on the amount of symbols in the scope
+    Symbol **slots;
+    int slot_count, symbol_count;
+    //tree structure, NO_SCOPE if there is no such scope
+    int parent, first_child, last_child, next_sibling;
+    int child_count;
+    Arena *arena;
 } Scope;
 
-//TODO no need to have 'public' headers
-
-Scope *new_scope();
-
-void free_scope(Scope *scope);
-
+//important: the interned id of symbol has to be set
 void scope_add_symbol(Scope *scope, Symbol *symbol);
 
-void scope_add_scope(Scope *scope, Scope *add_scope);
+//symbol with the interned id defined directly in scope, NULL if there is none
+Symbol *scope_get_symbol(Scope *scope, int id);
+
+//name of an AST node resolved by semantic analysis
+typedef struct {
+    //symbol the name refers to, NULL for nodes without a name
+    Symbol *symbol;
+    //id of the scope the node itself is in (symbol is local if it is defined in this scope)
+    //ND_COND_TRUE and ND_COND_FALSE are in the scope they open, NO_SCOPE if the node was not analyzed
+    int scope;
+} Resolution;
 
 typedef struct {
-    Stack *current;
-    Scope *root_scope;
+    //all scopes, indexed by their id
+    //important: the array moves when it grows, do not keep pointers to scopes while adding new ones
+    Scope *scopes;
+    int scope_count, scope_capacity;
+    //id of the scope that symbols are added to and looked up from
+    int current;
+    //symbol names are indices into this token list
+    Token_List *tokens;
+    //symbols, scopes and the table itself are allocated from this arena and released with it
+    Arena *arena;
+    //one entry per node of the flat AST, indexed like the nodes, filled by semantic analysis
+    //(kept beside the AST, because a cached AST is mapped read-only)
+    Resolution *resolved;
+    int resolved_count;
+    //lookups in the root scope only see symbols whose name token is below this (INT_MAX by default)
+    //parallel analysis uses it to hide the root symbols that are defined after a function from its body
+    int visible_end;
+    //amount of symbol_table_get and symbol_table_is_local calls on this table (a view counts its own lookups)
+    //only semantic analysis looks up names, later steps read the resolutions
+    long lookups;
 } Symbol_Table;
 
-Symbol_Table *new_symbol_table();
+Symbol_Table *new_symbol_table(Token_List *tokens, Arena *arena);
+
+//drop all scopes, symbols and resolutions (their memory stays in the arena)
+void symbol_table_clear(Symbol_Table *table);
+
+//make room for count scopes in total, so the scope array does not move while views add scopes
+void symbol_table_reserve_scopes(Symbol_Table *table, int count);
+
+//hand out the next count scope ids without creating the scopes, a view creates them later (see symbol_table_enter_reserved)
+void symbol_table_skip_scopes(Symbol_Table *table, int count);
+
+//table that shares the scopes and resolutions of table, but has its own current scope, tokens and arena
+//important: views may only add scopes that were reserved for them
+Symbol_Table *symbol_table_view(Symbol_Table *table, Token_List *tokens, Arena *arena);
 
-void free_symbol_table(Symbol_Table *table);
+//enter the existing (still empty) scope of a view, the reserved scopes after it are created by the next pushes
+//the scope and its symbols are allocated from the arena of the view from now on
+void symbol_table_enter_reserved(Symbol_Table *view, int scope, int visible_end);
 
-//create new scope
+#define symbol_table_scope(table, id) (&(table)->scopes[id])
+
+//create new scope as the last child of the current scope and enter it
 void symbol_table_push(Symbol_Table *table);
 
-//return to parent scope
+//return to parent scope (stays in the root scope)
 void symbol_table_pop(Symbol_Table *table);
 
+//set current scope to any existing scope
+void symbol_table_enter(Symbol_Table *table, int scope);
+
 //reset current scope to root scope
 void symbol_table_reset_current(Symbol_Table *table);
 
@@ -109,9 +152,24 @@ void symbol_table_walk_next(Symbol_Table *table);
 void symbol_table_set(Symbol_Table *table, Symbol *symbol);
 
 //get symbol by name starting from current scope (descending through scopes)
-Symbol *symbol_table_get(Symbol_Table *table, Token *name);
+Symbol *symbol_table_get(Symbol_Table *table, int name);
 
 //check if symbol is defined in the current scope only and return the Symbol in that case
-Symbol *symbol_table_is_local(Symbol_Table *table, Token *name);
+Symbol *symbol_table_is_local(Symbol_Table *table, int name);
+
+//allocate an empty resolution for each of the node_count nodes of an AST
+void symbol_table_init_resolved(Symbol_Table *table, int node_count);
+
+//remember that node is in the current scope (and refers to symbol, if it is not NULL)
+void symbol_table_resolve(Symbol_Table *table, int node, Symbol *symbol);
+
+//symbol node was resolved to, NULL if it was not resolved
+Symbol *resolved_symbol(Symbol_Table *table, int node);
+
+//id of the scope node is in, see Resolution
+int resolved_scope(Symbol_Table *table, int node);
+
+//check if the symbol node was resolved to is defined in the scope of node itself
+int resolved_is_local(Symbol_Table *table, int node);
 
 #endif
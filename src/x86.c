@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "x86.h"
+
+//64-bit operand size
+#define REX_W 0x48
+//rm of a memory operand based on rbp (mod 01 and 10 take a displacement)
+#define RM_RBP 5
+#define MOD_DISP8 1
+#define MOD_DISP32 2
+#define MOD_REGISTER 3
+
+#define fits_int8(value) ((value) >= -128 && (value) <= 127)
+#define fits_int32(value) ((value) >= -2147483648L && (value) <= 2147483647L)
+
+//opcodes of the arithmetic instructions, indexed by Asm_Opcode
+//r/m64 += r64, r64 += r/m64 and the /digit of r/m64 += imm
+typedef struct {
+    unsigned char to_rm, from_rm, digit;
+} Arithmetic;
+
+static const Arithmetic arithmetic[] = {
+    [ASM_ADD] = { 0x01, 0x03, 0 },
+    [ASM_SUB] = { 0x29, 0x2B, 5 },
+    [ASM_CMP] = { 0x39, 0x3B, 7 },
+};
+
+Code_Links *new_code_links() {
+    Code_Links *new = malloc(sizeof(Code_Links));
+    new->labels = NULL;
+    new->label_capacity = 0;
+    new->jumps = NULL;
+    new->jump_labels = NULL;
+    new->jump_count = 0;
+    new->jump_capacity = 0;
+    return new;
+}
+
+void free_code_links(Code_Links *links) {
+    free(links->labels);
+    free(links->jumps);
+    free(links->jump_labels);
+    free(links);
+}
+
+static void write_int32(Output_Buffer *code, long value) {
+    char bytes[4] = { value, value >> 8, value >> 16, value >> 24 };
+    output_bytes(code, bytes, 4);
+}
+
+static void write_int64(Output_Buffer *code, long value) {
+    write_int32(code, value);
+    write_int32(code, value >> 32);
+}
+
+//ModRM byte (and displacement) of operand, reg is a register or the /digit of the opcode
+static void write_modrm(Output_Buffer *code, int reg, Operand operand) {
+    if (operand.kind == OPERAND_REGISTER) {
+        output_char(code, MOD_REGISTER << 6 | reg << 3 | operand.reg);
+        return;
+    }
+    //[rbp - offset]
+    long displacement = -operand.value;
+    if (fits_int8(displacement)) {
+        output_char(code, MOD_DISP8 << 6 | reg << 3 | RM_RBP);
+        output_char(code, displacement);
+    }
+    else {
+        output_char(code, MOD_DISP32 << 6 | reg << 3 | RM_RBP);
+        write_int32(code, displacement);
+    }
+}
+
+void x86_op0(Output_Buffer *code, Asm_Opcode opcode) {
+    if (opcode == ASM_RET) {
+        output_char(code, 0xC3);
+    }
+    else if (opcode == ASM_NOP) {
+        output_char(code, 0x90);
+    }
+    else {
+        //syscall
+        output_literal(code, "\x0F\x05");
+    }
+}
+
+void x86_op1(Output_Buffer *code, Asm_Opcode opcode, Operand operand) {
+    if (opcode == ASM_POP) {
+        output_char(code, 0x58 + operand.reg);
+    }
+    else if (operand.kind == OPERAND_REGISTER) {
+        output_char(code, 0x50 + operand.reg);
+    }
+    else if (operand.kind == OPERAND_STACK) {
+        output_char(code, 0xFF);
+        write_modrm(code, 6, operand);
+    }
+    else if (fits_int8(operand.value)) {
+        output_char(code, 0x6A);
+        output_char(code, operand.value);
+    }
+    else {
+        output_char(code, 0x68);
+        write_int32(code, operand.value);
+    }
+}
+
+void x86_op2(Output_Buffer *code, Asm_Opcode opcode, Operand dst, Operand src) {
+    if (opcode == ASM_MOV) {
+        if (src.kind == OPERAND_IMMEDIATE && dst.kind == OPERAND_REGISTER) {
+            if (src.value >= 0 && src.value <= 0xFFFFFFFFL) {
+                //32-bit mov zero extends to the whole register
+                output_char(code, 0xB8 + dst.reg);
+                write_int32(code, src.value);
+            }
+            else if (fits_int32(src.value)) {
+                output_char(code, REX_W);
+                output_char(code, 0xC7);
+                write_modrm(code, 0, dst);
+                write_int32(code, src.value);
+            }
+            else {
+                output_char(code, REX_W);
+                output_char(code, 0xB8 + dst.reg);
+                write_int64(code, src.value);
+            }
+        }
+        else if (src.kind == OPERAND_IMMEDIATE) {
+            output_char(code, REX_W);
+            output_char(code, 0xC7);
+            write_modrm(code, 0, dst);
+            write_int32(code, src.value);
+        }
+        else if (src.kind == OPERAND_REGISTER) {
+            output_char(code, REX_W);
+            output_char(code, 0x89);
+            write_modrm(code, src.reg, dst);
+        }
+        else {
+            output_char(code, REX_W);
+            output_char(code, 0x8B);
+            write_modrm(code, dst.reg, src);
+        }
+        return;
+    }
+
+    Arithmetic instruction = arithmetic[opcode];
+    output_char(code, REX_W);
+    if (src.kind == OPERAND_IMMEDIATE) {
+        if (fits_int8(src.value)) {
+            output_char(code, 0x83);
+            write_modrm(code, instruction.digit, dst);
+            output_char(code, src.value);
+        }
+        else {
+            output_char(code, 0x81);
+            write_modrm(code, instruction.digit, dst);
+            write_int32(code, src.value);
+        }
+    }
+    else if (src.kind == OPERAND_REGISTER) {
+        output_char(code, instruction.to_rm);
+        write_modrm(code, src.reg, dst);
+    }
+    else {
+        output_char(code, instruction.from_rm);
+        write_modrm(code, dst.reg, src);
+    }
+}
+
+//make sure label is a valid index into the labels of links
+static void reserve_label(Code_Links *links, int label) {
+    if (label < links->label_capacity) {
+        return;
+    }
+    int capacity = links->label_capacity == 0 ? 64 : links->label_capacity;
+    while (capacity <= label) {
+        capacity *= 2;
+    }
+    links->labels = realloc(links->labels, capacity * sizeof(Code_Position));
+    for (int i = links->label_capacity; i < capacity; i++) {
+        links->labels[i].section = NO_SECTION;
+    }
+    links->label_capacity = capacity;
+}
+
+void x86_jump(Output_Buffer *code, Code_Links *links, int section, Asm_Opcode opcode, int label) {
+    if (opcode == ASM_JMP) {
+        output_char(code, 0xE9);
+    }
+    else if (opcode == ASM_CALL) {
+        output_char(code, 0xE8);
+    }
+    else {
+        output_char(code, 0x0F);
+        output_char(code, opcode == ASM_JE ? 0x84 : 0x85);
+    }
+    if (links->jump_count == links->jump_capacity) {
+        links->jump_capacity = links->jump_capacity == 0 ? 64 : links->jump_capacity * 2;
+        links->jumps = realloc(links->jumps, links->jump_capacity * sizeof(Code_Position));
+        links->jump_labels = realloc(links->jump_labels, links->jump_capacity * sizeof(int));
+    }
+    links->jumps[links->jump_count] = (Code_Position) { section, code->size };
+    links->jump_labels[links->jump_count] = label;
+    links->jump_count += 1;
+    //patched by x86_link
+    write_int32(code, 0);
+}
+
+void x86_label(Output_Buffer *code, Code_Links *links, int section, int label) {
+    reserve_label(links, label);
+    links->labels[label] = (Code_Position) { section, code->size };
+}
+
+int x86_link(Code_Links *links, Output_Buffer **sections, int section_count, Output_Buffer *out) {
+    //offset of every section inside of the linked code
+    long *starts = malloc(section_count * sizeof(long));
+    long base = out->size;
+    for (int i = 0; i < section_count; i++) {
+        starts[i] = out->size - base;
+        if (sections[i] != NULL) {
+            output_bytes(out, sections[i]->data, sections[i]->size);
+        }
+    }
+
+    char *linked = out->data + base;
+    for (int i = 0; i < links->jump_count; i++) {
+        int label = links->jump_labels[i];
+        if (label >= links->label_capacity || links->labels[label].section == NO_SECTION) {
+            printf("INTERNAL ERROR: jump to undefined label %d\n", label);
+            free(starts);
+            return 1;
+        }
+        Code_Position target = links->labels[label];
+        Code_Position jump = links->jumps[i];
+        long field = starts[jump.section] + jump.offset;
+        //displacement is relative to the end of the instruction, which ends with the displacement
+        long displacement = starts[target.section] + target.offset - (field + 4);
+        for (int byte = 0; byte < 4; byte++) {
+            linked[field + byte] = displacement >> (8 * byte);
+        }
+    }
+    free(starts);
+    return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef X86_H
+#define X86_H
+
+#include "output.h"
+
+//encoder for the x86-64 instructions generated by codegen (see asm.h for the operands)
+//code is generated in sections (the main code and every function), jumps between them are resolved by x86_link
+
+typedef enum {
+    REG_RAX = 0, REG_RBX = 3, REG_RSP = 4, REG_RBP = 5, REG_RDI = 7,
+} Register;
+
+typedef enum {
+    ASM_MOV, ASM_ADD, ASM_SUB, ASM_CMP, ASM_PUSH, ASM_POP, ASM_JMP, ASM_JE, ASM_JNE, ASM_CALL, ASM_RET, ASM_NOP, ASM_SYSCALL,
+} Asm_Opcode;
+
+typedef enum {
+    OPERAND_REGISTER, OPERAND_STACK, OPERAND_IMMEDIATE,
+} Operand_Kind;
+
+//register, 64-bit stack slot [rbp - offset] or immediate value
+typedef struct {
+    Operand_Kind kind;
+    Register reg;
+    //offset of a stack slot, value of an immediate
+    long value;
+} Operand;
+
+#define NO_SECTION -1
+
+//position of a label or of the 32-bit displacement of a jump, relative to the start of its section
+typedef struct {
+    int section;
+    long offset;
+} Code_Position;
+
+//labels and jumps of all sections, labels are numbered by the caller
+typedef struct {
+    //indexed by label, section is NO_SECTION until the label is defined
+    Code_Position *labels;
+    int label_capacity;
+    //displacements of jumps that are patched by x86_link
+    Code_Position *jumps;
+    int *jump_labels;
+    int jump_count, jump_capacity;
+} Code_Links;
+
+Code_Links *new_code_links();
+
+void free_code_links(Code_Links *links);
+
+//instruction without operands (ret, nop, syscall)
+void x86_op0(Output_Buffer *code, Asm_Opcode opcode);
+
+//instruction with a single operand (push, pop of a register)
+void x86_op1(Output_Buffer *code, Asm_Opcode opcode, Operand operand);
+
+//instruction with a destination and a source operand (mov, add, sub, cmp)
+//at most one operand can be a stack slot, immediates of memory destinations and arithmetic are 32-bit (sign extended)
+void x86_op2(Output_Buffer *code, Asm_Opcode opcode, Operand dst, Operand src);
+
+//jump or call to label (always with a 32-bit displacement), label can be defined later or in another section
+void x86_jump(Output_Buffer *code, Code_Links *links, int section, Asm_Opcode opcode, int label);
+
+//define label at the current end of the code of section
+void x86_label(Output_Buffer *code, Code_Links *links, int section, int label);
+
+//append all sections to out (in order of their index) and patch the displacements of all jumps
+//return 1 (after reporting the error) if a jump targets an undefined label
+int x86_link(Code_Links *links, Output_Buffer **sections, int section_count, Output_Buffer *out);
+
+#endif
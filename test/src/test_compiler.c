@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "../../src/pool.h"
+#include "../../src/compiler.h"
+#include "../../src/analysis.h"
+#include "../../src/bytegen.h"
+
+#define PROGRAM_COUNT 256
+#define VARIANT_COUNT 16
+#define THREAD_COUNT 8
+
+//Fixtures
+
+//program made of the given variant, different variants use different amounts of functions, nesting and conditions
+char *generate_variant(int variant, long *size) {
+    char *text = malloc(4096 + variant * 512);
+    long pos = sprintf(text, "a = %d\nb = a + 1\n", variant);
+    for (int i = 0; i <= variant; i++) {
+        pos += sprintf(text + pos, "function f%d {\n    c = a - %d\n", i, i);
+        if (i % 3 == 0) {
+            pos += sprintf(text + pos, "    function g {\n        if (c == b) { c = 1 } else { g() }\n    }\n    g()\n");
+        }
+        pos += sprintf(text + pos, "}\n");
+        if (i % 2 == 0) {
+            pos += sprintf(text + pos, "if (a != %d) { f%d() }\n", i, i);
+        }
+    }
+    *size = pos;
+    return text;
+}
+
+typedef struct {
+    char *text;
+    long size;
+    //generated assembly and the result of compile
+    char *output;
+    size_t output_size;
+    int err;
+} Compilation;
+
+void run_compilation(void *arg) {
+    Compilation *compilation = arg;
+    FILE *out_file = open_memstream(&compilation->output, &compilation->output_size);
+    Compiler_Context *context = new_compiler_context();
+    compilation->err = compile(context, new_source(compilation->text, compilation->size), out_file);
+    free_compiler_context(context);
+    fclose(out_file);
+}
+
+//Tests
+
+//a second compilation in the same process has to produce exactly the same output as the first one
+int test_compile_twice() {
+    int err;
+    Compilation first = { 0 }, second = { 0 };
+    first.text = second.text = generate_variant(VARIANT_COUNT - 1, &first.size);
+    second.size = first.size;
+    run_compilation(&first);
+    run_compilation(&second);
+
+    err = assert_int(first.err, 0);
+    if (err) return err;
+    err = assert_int(second.err, 0);
+    if (err) return err;
+    err = assert_int(first.output_size == second.output_size && memcmp(first.output, second.output, first.output_size) == 0, TRUE);
+    if (err) return err;
+
+    return 0;
+}
+
+//compile many programs at the same time, every output has to match the serial compilation of the same program
+int test_concurrent_compilations() {
+    int err;
+    Compilation expected[VARIANT_COUNT] = { 0 };
+    for (int i = 0; i < VARIANT_COUNT; i++) {
+        expected[i].text = generate_variant(i, &expected[i].size);
+        run_compilation(&expected[i]);
+        err = assert_int(expected[i].err, 0);
+        if (err) return err;
+    }
+
+    Compilation *compilations = calloc(PROGRAM_COUNT, sizeof(Compilation));
+    Thread_Pool *pool = new_thread_pool(THREAD_COUNT);
+    for (int i = 0; i < PROGRAM_COUNT; i++) {
+        compilations[i].text = expected[i % VARIANT_COUNT].text;
+        compilations[i].size = expected[i % VARIANT_COUNT].size;
+        thread_pool_submit(pool, run_compilation, &compilations[i]);
+    }
+    thread_pool_wait(pool);
+    free_thread_pool(pool);
+
+    for (int i = 0; i < PROGRAM_COUNT; i++) {
+        Compilation *actual = &compilations[i];
+        Compilation *reference = &expected[i % VARIANT_COUNT];
+        err = assert_int(actual->err, 0);
+        if (err) return err;
+        err = assert_int(actual->output_size == reference->output_size && memcmp(actual->output, reference->output, reference->output_size) == 0, TRUE);
+        if (err) {
+            printf("output of program %d differs\n", i);
+            return err;
+        }
+    }
+
+    return 0;
+}
+
+//functions with the same name in different scopes each keep their own code, all functions are written in order of their mangle index
+int test_same_named_functions() {
+    int err;
+    Compilation compilation = { 0 };
+    compilation.text = "function f {\n    function g {\n        a = 1\n    }\n    g()\n}\nfunction h {\n    function g {\n        b = 2\n    }\n    g()\n}\nf()\nh()\n";
+    compilation.size = strlen(compilation.text);
+    run_compilation(&compilation);
+    err = assert_int(compilation.err, 0);
+    if (err) return err;
+
+    //f and h are numbered first (root scope), then the g of f, then the g of h
+    char *labels[] = { "\nf_0:\n", "\nh_1:\n", "\ng_2:\n", "\ng_3:\n" };
+    char *previous = compilation.output;
+    for (int i = 0; i < 4; i++) {
+        char *label = strstr(compilation.output, labels[i]);
+        err = assert_int(label != NULL && label > previous, TRUE);
+        if (err) {
+            printf("label %d is missing or out of order\n", i);
+            return err;
+        }
+        previous = label;
+    }
+    //the body of the first g must not have been replaced by the second one
+    err = assert_int(strstr(compilation.output, "push 1\n") != NULL && strstr(compilation.output, "push 2\n") != NULL, TRUE);
+    if (err) return err;
+
+    return 0;
+}
+
+//names are only looked up by semantic analysis, codegen (assembly and machine code) and bytegen only read the resolutions
+int test_codegen_no_lookups() {
+    int err;
+    long size;
+    char *text = generate_variant(VARIANT_COUNT - 1, &size);
+    char *output;
+    size_t output_size;
+    FILE *out_file = open_memstream(&output, &output_size);
+    Compiler_Context *context = new_compiler_context();
+    //the program loops forever, so it is only compiled to an executable (and bytecode) and never run
+    context->executable_file = tmpfile();
+    err = assert_int(compile(context, new_source(text, size), out_file), 0);
+    if (err) return err;
+    err = assert_int(bytegen(context), 0);
+    if (err) return err;
+    fclose(out_file);
+    fclose(context->executable_file);
+
+    //the lookups of the analysis alone on the same AST
+    Arena *arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+    Symbol_Table *table = new_symbol_table(context->tokens, arena);
+    err = assert_int(semantic_analysis(context->ast, table), 0);
+    if (err) return err;
+    err = assert_int(table->lookups > 0, TRUE);
+    if (err) return err;
+    err = assert_int(context->table->lookups, table->lookups);
+    if (err) {
+        printf("%ld lookups after analysis\n", context->table->lookups - table->lookups);
+        return err;
+    }
+
+    free_arena(arena);
+    free_compiler_context(context);
+    free(output);
+    free(text);
+    return 0;
+}
+
+int main() {
+    gather_tests(
+        test_compile_twice,
+        test_same_named_functions,
+        test_concurrent_compilations,
+        test_codegen_no_lookups,
+        NULL
+    );
+}
@@ -0,0 +1,436 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "test.h"
+#include "../../src/compiler.h"
+#include "../../src/codegen.h"
+#include "../../src/jit.h"
+
+#define MAX_VARS 16
+#define PATH_SIZE 256
+
+//Fixtures
+
+typedef struct {
+    char *text;
+    //values of the variables of the root scope (in order of declaration) when the program exits
+    long expected[MAX_VARS];
+    int var_count;
+} Program;
+
+Program programs[] = {
+    //every form of assignment, small and large immediates
+    {
+        "a = 5\n"
+        "b = a + 3\n"
+        "c = 10 - b\n"
+        "d = a + b\n"
+        "d = d - 1\n"
+        "e = 7\n"
+        "e = 2 + 3\n"
+        "e = e + a\n"
+        "b = 300000\n"
+        "c = c + 200\n"
+        "f = 100000 - c\n"
+        "g = 4000000000 + 1\n"
+        "h = 5000000000 + 0\n"
+        "i = a - 1\n"
+        "i = a\n",
+        { 5, 300000, 202, 12, 10, 99798, 4000000001, 5000000000, 5 }, 9,
+    },
+    //nested conditions with and without else, every kind of comparison
+    {
+        "a = 1\n"
+        "b = 2\n"
+        "c = 0\n"
+        "if (a == 1) {\n"
+        "    if (b != 2) {\n"
+        "        a = 100\n"
+        "    }\n"
+        "    if (2 == b) {\n"
+        "        b = 20\n"
+        "    } else {\n"
+        "        b = 30\n"
+        "    }\n"
+        "} else {\n"
+        "    a = 50\n"
+        "}\n"
+        "if (3 == 4) {\n"
+        "    a = 7\n"
+        "} else {\n"
+        "    a = a + 10\n"
+        "}\n"
+        "if (a != b) {\n"
+        "    c = 1\n"
+        "} else {\n"
+        "    c = 2\n"
+        "}\n",
+        { 11, 20, 1 }, 3,
+    },
+    //call and recursion (a call of the enclosing function jumps back to its start)
+    {
+        "n = 0\n"
+        "total = 0\n"
+        "function count {\n"
+        "    n = n + 1\n"
+        "    total = total + 5\n"
+        "    if (n != 4) {\n"
+        "        count()\n"
+        "    }\n"
+        "}\n"
+        "count()\n",
+        { 4, 20 }, 2,
+    },
+    //function with local variables and a condition
+    {
+        "x1 = 1 + 2\n"
+        "function abc {\n"
+        "    if (x1 == 3) {\n"
+        "        x1 = x1 + 1\n"
+        "    } else {\n"
+        "        x1 = x1 + 2\n"
+        "    }\n"
+        "    x2 = x1 + 1\n"
+        "    x3 = x1 + x2\n"
+        "    x1 = x3\n"
+        "}\n"
+        "abc()\n",
+        { 9 }, 1,
+    },
+};
+
+#define PROGRAM_COUNT (int) (sizeof(programs) / sizeof(Program))
+
+//compile program to directory/out (and the assembly to directory/out.asm)
+//the context is returned for the stack slots of the variables, NULL if the compilation failed
+Compiler_Context *compile_program(Program *program, char *directory) {
+    char path[PATH_SIZE];
+    snprintf(path, PATH_SIZE, "%s/out.asm", directory);
+    FILE *asm_file = fopen(path, "w");
+    snprintf(path, PATH_SIZE, "%s/out", directory);
+    FILE *executable_file = fopen(path, "w");
+    if (asm_file == NULL || executable_file == NULL) {
+        return NULL;
+    }
+    Compiler_Context *context = new_compiler_context();
+    context->executable_file = executable_file;
+    int err = compile(context, new_source(program->text, strlen(program->text)), asm_file);
+    fclose(asm_file);
+    fclose(executable_file);
+    chmod(path, 0700);
+    if (err) {
+        free_compiler_context(context);
+        return NULL;
+    }
+    return context;
+}
+
+//stack slots of the variables of the root scope, return the amount of variables
+int root_var_slots(Compiler_Context *context, int *offsets) {
+    int count = 0;
+    Scope *root = symbol_table_scope(context->table, ROOT_SCOPE);
+    for (Collection_Container *container = root->symbols->root; container != NULL; container = container->next) {
+        Symbol *symbol = container->item;
+        if (symbol->type == SYM_INT && count < MAX_VARS) {
+            offsets[count] = stack_addr(symbol);
+            count += 1;
+        }
+    }
+    return count;
+}
+
+//slots of the variables of the root scope in the bytecode of the context, return the amount of variables
+int root_var_addrs(Compiler_Context *context, int *addrs) {
+    int count = 0;
+    Scope *root = symbol_table_scope(context->table, ROOT_SCOPE);
+    for (Collection_Container *container = root->symbols->root; container != NULL; container = container->next) {
+        Symbol *symbol = container->item;
+        if (symbol->type == SYM_INT && count < MAX_VARS) {
+            addrs[count] = symbol->addr;
+            count += 1;
+        }
+    }
+    return count;
+}
+
+//run the executable at path until it makes the exit syscall and read the 64-bit value at [rbp - offset] for every offset
+//return 1 if the program never got to the exit syscall (crashed or exited in another way)
+int run_to_exit(char *path, int *offsets, int count, long *values) {
+    pid_t child = fork();
+    if (child == 0) {
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        execl(path, path, NULL);
+        _exit(127);
+    }
+    int status;
+    //the child stops right after exec
+    waitpid(child, &status, 0);
+    while (WIFSTOPPED(status) && WSTOPSIG(status) == SIGTRAP) {
+        struct user_regs_struct regs;
+        ptrace(PTRACE_GETREGS, child, NULL, &regs);
+        if (regs.orig_rax == SYS_exit) {
+            for (int i = 0; i < count; i++) {
+                values[i] = ptrace(PTRACE_PEEKDATA, child, (void *) (regs.rbp - offsets[i]), NULL);
+            }
+            kill(child, SIGKILL);
+            waitpid(child, &status, 0);
+            return 0;
+        }
+        //continue to the next syscall
+        ptrace(PTRACE_SYSCALL, child, NULL, NULL);
+        waitpid(child, &status, 0);
+    }
+    if (WIFSTOPPED(status)) {
+        kill(child, SIGKILL);
+        waitpid(child, &status, 0);
+    }
+    return 1;
+}
+
+//Tests
+
+//executables written by the built-in encoder compute the expected values
+int test_executable_values() {
+    int err;
+    char directory[] = "/tmp/test_executable_XXXXXX";
+    if (mkdtemp(directory) == NULL) return 1;
+    char path[PATH_SIZE];
+    snprintf(path, PATH_SIZE, "%s/out", directory);
+
+    for (int i = 0; i < PROGRAM_COUNT; i++) {
+        Compiler_Context *context = compile_program(&programs[i], directory);
+        err = assert_int(context != NULL, TRUE);
+        if (err) return err;
+        int offsets[MAX_VARS];
+        long values[MAX_VARS];
+        int count = root_var_slots(context, offsets);
+        err = assert_int(count, programs[i].var_count);
+        if (err) return err;
+        err = run_to_exit(path, offsets, count, values);
+        if (err) {
+            printf("program %d did not exit\n", i);
+            return err;
+        }
+        for (int var = 0; var < count; var++) {
+            if (values[var] != programs[i].expected[var]) {
+                printf("program %d: var %d is %ld, expected %ld\n", i, var, values[var], programs[i].expected[var]);
+                return 1;
+            }
+        }
+        free_compiler_context(context);
+    }
+    return 0;
+}
+
+//the executable of the built-in encoder behaves exactly like the one of nasm and ld built from the generated assembly
+int test_executable_matches_nasm() {
+    int err;
+    if (system("command -v nasm > /dev/null && command -v ld > /dev/null") != 0) {
+        printf("nasm or ld not found, comparison skipped\n");
+        return 0;
+    }
+    char directory[] = "/tmp/test_executable_XXXXXX";
+    if (mkdtemp(directory) == NULL) return 1;
+    char path[PATH_SIZE], reference_path[PATH_SIZE], command[4 * PATH_SIZE];
+    snprintf(path, PATH_SIZE, "%s/out", directory);
+    snprintf(reference_path, PATH_SIZE, "%s/reference", directory);
+    snprintf(command, sizeof(command), "nasm -o %s/out.o -f elf64 %s/out.asm && ld -o %s %s/out.o", directory, directory, reference_path, directory);
+
+    for (int i = 0; i < PROGRAM_COUNT; i++) {
+        Compiler_Context *context = compile_program(&programs[i], directory);
+        err = assert_int(context != NULL, TRUE);
+        if (err) return err;
+        err = assert_int(system(command), 0);
+        if (err) return err;
+        int offsets[MAX_VARS];
+        long values[MAX_VARS], reference_values[MAX_VARS];
+        int count = root_var_slots(context, offsets);
+        err = assert_int(run_to_exit(path, offsets, count, values), 0);
+        if (err) return err;
+        err = assert_int(run_to_exit(reference_path, offsets, count, reference_values), 0);
+        if (err) return err;
+        err = assert_int(memcmp(values, reference_values, count * sizeof(long)) == 0, TRUE);
+        if (err) {
+            printf("program %d behaves differently\n", i);
+            return err;
+        }
+        free_compiler_context(context);
+    }
+    return 0;
+}
+
+//running the programs in process computes the same values
+int test_run_values() {
+    int err;
+    for (int i = 0; i < PROGRAM_COUNT; i++) {
+        Compiler_Context *context = new_compiler_context();
+        context->run = 1;
+        err = compile(context, new_source(programs[i].text, strlen(programs[i].text)), NULL);
+        err = assert_int(err, 0);
+        if (err) return err;
+        int offsets[MAX_VARS];
+        int count = root_var_slots(context, offsets);
+        for (int var = 0; var < count; var++) {
+            long value = jit_stack_slot(context->stack, offsets[var]);
+            if (value != programs[i].expected[var]) {
+                printf("program %d: var %d is %ld, expected %ld\n", i, var, value, programs[i].expected[var]);
+                return 1;
+            }
+        }
+        free_compiler_context(context);
+    }
+    return 0;
+}
+
+//code that crashes while running in process is reported as an error instead of killing the compiler
+int test_run_crash() {
+    //ud2 (SIGILL) and mov rax, [0] (SIGSEGV)
+    const char *crashes[] = { "\x0F\x0B", "\x48\x8B\x04\x25\x00\x00\x00\x00" };
+    const size_t sizes[] = { 2, 8 };
+    Jit_Stack *stack = new_jit_stack(JIT_STACK_SIZE);
+    struct sigaction before, after;
+    sigaction(SIGSEGV, NULL, &before);
+    for (int i = 0; i < 2; i++) {
+        Output_Buffer *code = new_output_buffer(NO_FD);
+        output_bytes(code, crashes[i], sizes[i]);
+        int err = assert_int(jit_run(code, stack), 2);
+        if (err) return err;
+        free_output_buffer(code);
+    }
+    //the handler of the host is restored and the next program (a single ret) runs normally
+    sigaction(SIGSEGV, NULL, &after);
+    int err = assert_int(after.sa_handler == before.sa_handler, TRUE);
+    if (err) return err;
+    Output_Buffer *code = new_output_buffer(NO_FD);
+    output_char(code, '\xC3');
+    err = assert_int(jit_run(code, stack), 0);
+    if (err) return err;
+    free_output_buffer(code);
+    free_jit_stack(stack);
+    return 0;
+}
+
+//interpreting the bytecode of the programs computes the same values
+int test_interpret_values() {
+    int err;
+    for (int i = 0; i < PROGRAM_COUNT; i++) {
+        Compiler_Context *context = new_compiler_context();
+        context->interpret = 1;
+        err = compile(context, new_source(programs[i].text, strlen(programs[i].text)), NULL);
+        err = assert_int(err, 0);
+        if (err) return err;
+        //no machine code is generated for the interpreter
+        err = assert_int(context->code == NULL, TRUE);
+        if (err) return err;
+        int addrs[MAX_VARS];
+        int count = root_var_addrs(context, addrs);
+        for (int var = 0; var < count; var++) {
+            long value = context->slots[addrs[var]];
+            if (value != programs[i].expected[var]) {
+                printf("program %d: var %d is %ld, expected %ld\n", i, var, value, programs[i].expected[var]);
+                return 1;
+            }
+        }
+        free_compiler_context(context);
+    }
+    return 0;
+}
+
+//programs that re-enter functions, run natively and interpreted
+Program reentry_programs[] = {
+    //long recursion loop with a nested function and an else case (only tail calls)
+    {
+        "counter = 100000\n"
+        "even = 0\n"
+        "odd = 0\n"
+        "parity = 0\n"
+        "function loop {\n"
+        "    if (counter != 0) {\n"
+        "        function step {\n"
+        "            counter = counter - 1\n"
+        "        }\n"
+        "        if (parity == 0) {\n"
+        "            even = even + 1\n"
+        "            parity = 1\n"
+        "        } else {\n"
+        "            odd = odd + 2\n"
+        "            parity = 0\n"
+        "        }\n"
+        "        step()\n"
+        "        loop()\n"
+        "    }\n"
+        "}\n"
+        "loop()\n",
+        { 0, 50000, 100000, 0 }, 4,
+    },
+    //a nested function enters its parent again with a jump, the return of the parent unwinds the nested call as well
+    {
+        "x = 0\n"
+        "y = 0\n"
+        "function f {\n"
+        "    function g {\n"
+        "        if (x == 0) {\n"
+        "            x = 1\n"
+        "            f()\n"
+        "        }\n"
+        "    }\n"
+        "    g()\n"
+        "    y = y + 1\n"
+        "}\n"
+        "f()\n",
+        { 1, 1 }, 2,
+    },
+};
+
+//the interpreter and the native code agree on programs that re-enter functions
+int test_interpret_matches_run() {
+    int err;
+    for (int i = 0; i < (int) (sizeof(reentry_programs) / sizeof(Program)); i++) {
+        char *text = reentry_programs[i].text;
+        Compiler_Context *run = new_compiler_context();
+        run->run = 1;
+        Compiler_Context *interpret = new_compiler_context();
+        interpret->interpret = 1;
+        err = assert_int(compile(run, new_source(text, strlen(text)), NULL), 0);
+        if (err) return err;
+        err = assert_int(compile(interpret, new_source(text, strlen(text)), NULL), 0);
+        if (err) return err;
+        int offsets[MAX_VARS], addrs[MAX_VARS];
+        int count = root_var_slots(run, offsets);
+        err = assert_int(count, reentry_programs[i].var_count);
+        if (err) return err;
+        err = assert_int(root_var_addrs(interpret, addrs), count);
+        if (err) return err;
+        for (int var = 0; var < count; var++) {
+            long native = jit_stack_slot(run->stack, offsets[var]);
+            long interpreted = interpret->slots[addrs[var]];
+            long expected = reentry_programs[i].expected[var];
+            if (native != expected || interpreted != expected) {
+                printf("program %d: var %d is %ld (native) and %ld (interpreted), expected %ld\n", i, var, native, interpreted, expected);
+                return 1;
+            }
+        }
+        free_compiler_context(run);
+        free_compiler_context(interpret);
+    }
+    return 0;
+}
+
+int main() {
+    gather_tests(
+        test_executable_values,
+        test_executable_matches_nasm,
+        test_run_values,
+        test_run_crash,
+        test_interpret_values,
+        test_interpret_matches_run,
+        NULL
+    );
+}
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "test.h"
+#include "../../src/parser.h"
+#include "../../src/flat.h"
+#include "../../src/cache.h"
+
+//Fixtures
+
+static Arena *fixture_arena = NULL;
+
+Arena *arena() {
+    if (fixture_arena == NULL) {
+        fixture_arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+    }
+    return fixture_arena;
+}
+
+Token_List *fixture_tokens(char *text, long size) {
+    Token_List *tokens = new_token_list();
+    if (tokenize(new_source(text, size), tokens)) {
+        return NULL;
+    }
+    return tokens;
+}
+
+AST_Node *parse_text(char *text) {
+    return parse(fixture_tokens(text, strlen(text)), arena());
+}
+
+//function body with statement_count assignments
+char *generate_function(int statement_count, long *size) {
+    char header[] = "function f {\n";
+    char statement[] = "x = x + 1\n";
+    char *text = malloc(sizeof(header) + statement_count * (sizeof(statement) - 1) + 2);
+    long pos = sprintf(text, "%s", header);
+    for (int i = 0; i < statement_count; i++) {
+        memcpy(text + pos, statement, sizeof(statement) - 1);
+        pos += sizeof(statement) - 1;
+    }
+    pos += sprintf(text + pos, "}\n");
+    *size = pos;
+    return text;
+}
+
+//function_count top-level functions with a few statements each, broken adds a syntax error to the middle one
+char *generate_functions(int function_count, int broken, long *size) {
+    char *text = malloc(function_count * 128L);
+    long pos = 0;
+    for (int i = 0; i < function_count; i++) {
+        pos += sprintf(text + pos, "x%d = %d\nfunction f%d {\n    y = x%d + 1\n    if (y != 2) { y = 2 } else { f%d() }\n}\n", i, i, i, i, i);
+        if (broken && i == function_count / 2) {
+            pos += sprintf(text + pos, "x = = 1\n");
+        }
+    }
+    *size = pos;
+    return text;
+}
+
+double seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//parse a function with statement_count statements, store the parse time in parse_time
+AST_Node *parse_function(int statement_count, double *parse_time) {
+    long size;
+    char *text = generate_function(statement_count, &size);
+    Token_List *tokens = fixture_tokens(text, size);
+    double start = seconds();
+    AST_Node *ast = parse(tokens, arena());
+    *parse_time = seconds() - start;
+    return ast;
+}
+
+//Tests
+
+int test_add_child() {
+    int err;
+    AST_Node *parent = new_ast_node(arena(), NO_TOKEN, ND_ROOT);
+    AST_Node *first = new_ast_node(arena(), NO_TOKEN, ND_INT);
+    AST_Node *second = new_ast_node(arena(), NO_TOKEN, ND_INT);
+
+    ast_node_add_child(parent, first);
+    ast_node_add_child(parent, second);
+
+    err = assert_int(parent->child_count, 2);
+    if (err) return err;
+    err = assert(parent->children, first);
+    if (err) return err;
+    err = assert(first->next, second);
+    if (err) return err;
+    err = assert(parent->last_child, second);
+    if (err) return err;
+
+    return 0;
+}
+
+int test_child_count() {
+    int err;
+    AST_Node *ast = parse_text("a = 1\nfunction f { b = a\nc = b }\nif (a == 1) { f() } else { }\nf()");
+    err = assert_not(ast, NULL);
+    if (err) return err;
+    err = assert_int(ast->child_count, 4);
+    if (err) return err;
+
+    AST_Node *function = ast->children->next;
+    err = assert_int(function->child_count, 2);
+    if (err) return err;
+
+    AST_Node *condition = function->next;
+    err = assert_int(condition->lhs->child_count, 1);
+    if (err) return err;
+    err = assert_int(condition->rhs->child_count, 0);
+    if (err) return err;
+    err = assert(condition->rhs->children, NULL);
+    if (err) return err;
+
+    return 0;
+}
+
+int test_syntax_error() {
+    int err;
+    err = assert(parse_text("function f { a = 1"), NULL);
+    if (err) return err;
+    err = assert(parse_text("a = 1 +"), NULL);
+    if (err) return err;
+    return 0;
+}
+
+int test_flatten() {
+    int err;
+    char text[] = "a = 1\nif (a == 1) { f() } else { b = a + 1 }";
+    Token_List *tokens = fixture_tokens(text, strlen(text));
+    Flat_AST *ast = flatten_ast(parse(tokens, arena()), tokens);
+
+    //root, assign (var, int), cond (bool (var, int), true (call), false (assign (var, add (var, int))))
+    err = assert_int(ast->count, 16);
+    if (err) return err;
+    err = assert_int(ast->nodes[0].size, 16);
+    if (err) return err;
+    err = assert_int(ast->nodes[0].payload, 2);
+    if (err) return err;
+
+    int cond = flat_end(ast, 1);
+    err = assert_int(flat_kind(ast, cond), ND_COND);
+    if (err) return err;
+    err = assert_int(flat_kind(ast, flat_cond_true(ast, cond)), ND_COND_TRUE);
+    if (err) return err;
+    int cond_false = flat_cond_false(ast, cond);
+    err = assert_int(flat_kind(ast, cond_false), ND_COND_FALSE);
+    if (err) return err;
+    err = assert_int(flat_end(ast, cond_false), ast->count);
+    if (err) return err;
+
+    //the call stores the interned id of its name
+    int call = flat_cond_true(ast, cond) + 1;
+    err = assert_int(ast->nodes[call].payload, token_id(tokens, ast->nodes[call].token));
+    if (err) return err;
+
+    return 0;
+}
+
+//parallel parsing has to produce exactly the same AST as a serial parse
+int test_parse_parallel() {
+    int err;
+    long size;
+    char *text = generate_functions(20000, FALSE, &size);
+    Token_List *tokens = fixture_tokens(text, size);
+    Flat_AST *serial = flatten_ast(parse(tokens, arena()), tokens);
+
+    Thread_Pool *pool = new_thread_pool(4);
+    tokens->current = 0;
+    AST_Node *parallel_ast = parse_parallel(tokens, arena(), pool);
+    free_thread_pool(pool);
+    err = assert_not(parallel_ast, NULL);
+    if (err) return err;
+    Flat_AST *parallel = flatten_ast(parallel_ast, tokens);
+
+    err = assert_int(parallel->count, serial->count);
+    if (err) return err;
+    err = assert_int(memcmp(parallel->nodes, serial->nodes, serial->count * sizeof(Flat_Node)), 0);
+    if (err) return err;
+    err = assert_int(token_list_current(tokens), NO_TOKEN);
+    if (err) return err;
+
+    return 0;
+}
+
+int test_parse_parallel_error() {
+    int err;
+    long size;
+    char *text = generate_functions(20000, TRUE, &size);
+    Token_List *tokens = fixture_tokens(text, size);
+    Thread_Pool *pool = new_thread_pool(4);
+    err = assert(parse_parallel(tokens, arena(), pool), NULL);
+    free_thread_pool(pool);
+    if (err) return err;
+    return 0;
+}
+
+//a stored cache has to map back to the same tokens and nodes, and a changed source must not hit it
+int test_ast_cache() {
+    int err;
+    char directory[] = "/tmp/test_ast_cache_XXXXXX";
+    err = assert_not(mkdtemp(directory), NULL);
+    if (err) return err;
+    char text[] = "a = 1\nfunction f {\n    b = a + 1\n}\nif (a == 1) { f() }";
+    Source *source = new_source(text, strlen(text));
+    Token_List *tokens = new_token_list();
+    tokenize(source, tokens);
+    Flat_AST *ast = flatten_ast(parse(tokens, arena()), tokens);
+
+    err = assert(load_ast_cache(directory, source), NULL);
+    if (err) return err;
+    err = assert_int(store_ast_cache(directory, source, tokens, ast), 0);
+    if (err) return err;
+
+    Ast_Cache *cache = load_ast_cache(directory, source);
+    err = assert_not(cache, NULL);
+    if (err) return err;
+    err = assert_int(cache->tokens->count, tokens->count);
+    if (err) return err;
+    err = assert_int(memcmp(cache->tokens->offsets, tokens->offsets, tokens->count * sizeof(long)), 0);
+    if (err) return err;
+    err = assert_int(memcmp(cache->tokens->ids, tokens->ids, tokens->count * sizeof(int)), 0);
+    if (err) return err;
+    err = assert_int(cache->ast->count, ast->count);
+    if (err) return err;
+    err = assert_int(memcmp(cache->ast->nodes, ast->nodes, ast->count * sizeof(Flat_Node)), 0);
+    if (err) return err;
+    free_ast_cache(cache);
+
+    //a cache file with any field out of range (that matches the source otherwise) is not used
+    char path[128];
+    sprintf(path, "%s/%016llx.ast", directory, source_hash(source));
+    FILE *file = fopen(path, "r+");
+    Cache_Header header;
+    err = assert_int(fread(&header, sizeof(header), 1, file), 1);
+    if (err) return err;
+    Flat_Node node = ast->nodes[2];
+    long offset = tokens->offsets[0];
+    int length = tokens->lengths[0];
+    Token_Type type = tokens->types[0];
+    //subtree past the end, unknown kind, token index past the end, token past the end of the source, unknown token type
+    Flat_Node corrupt_nodes[] = {
+        { node.kind, node.flags, ast->count, node.token, node.payload },
+        { ND_SUB + 1, node.flags, node.size, node.token, node.payload },
+        { node.kind, node.flags, node.size, tokens->count, node.payload },
+        node, node,
+    };
+    long corrupt_offsets[] = { offset, offset, offset, strlen(text) - length + 1, offset };
+    Token_Type corrupt_types[] = { type, type, type, type, TK_EOF };
+    for (int i = 0; i < 5; i++) {
+        fseek(file, header.nodes_offset + 2 * sizeof(Flat_Node), SEEK_SET);
+        fwrite(&corrupt_nodes[i], sizeof(Flat_Node), 1, file);
+        fseek(file, header.offsets_offset, SEEK_SET);
+        fwrite(&corrupt_offsets[i], sizeof(long), 1, file);
+        fseek(file, header.types_offset, SEEK_SET);
+        fwrite(&corrupt_types[i], sizeof(Token_Type), 1, file);
+        fflush(file);
+        err = assert(load_ast_cache(directory, source), NULL);
+        if (err) {
+            printf("corruption %d was not detected\n", i);
+            return err;
+        }
+    }
+    fclose(file);
+
+    char changed[] = "a = 2\nfunction f {\n    b = a + 1\n}\nif (a == 1) { f() }";
+    err = assert(load_ast_cache(directory, new_source(changed, strlen(changed))), NULL);
+    if (err) return err;
+
+    char command[64];
+    sprintf(command, "rm -rf %s", directory);
+    system(command);
+    return 0;
+}
+
+//appending a statement has to be O(1): 10x the statements may only take ~10x the time (not ~100x)
+int test_linear_scaling() {
+    int err;
+    double small_time, large_time;
+    AST_Node *small = parse_function(100000, &small_time);
+    AST_Node *large = parse_function(1000000, &large_time);
+
+    err = assert_int(small->children->child_count, 100000);
+    if (err) return err;
+    err = assert_int(large->children->child_count, 1000000);
+    if (err) return err;
+
+    //generous bound for noisy machines, quadratic appends are far above it
+    err = assert_int(large_time < small_time * 30, TRUE);
+    if (err) {
+        printf("10^5 statements: %.3f ms, 10^6 statements: %.3f ms\n", small_time * 1e3, large_time * 1e3);
+        return err;
+    }
+
+    return 0;
+}
+
+int main() {
+    gather_tests(
+        test_add_child,
+        test_child_count,
+        test_syntax_error,
+        test_flatten,
+        test_parse_parallel,
+        test_parse_parallel_error,
+        test_ast_cache,
+        test_linear_scaling,
+        NULL
+    );
+}
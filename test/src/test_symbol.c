@@ -1,18 +1,43 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include "test.h"
 #include "../../src/symbol.h"
 #include "../../src/lexer.h"
+#include "../../src/flat.h"
+#include "../../src/analysis.h"
+#include "../../src/pool.h"
 
 //Fixtures
 
+//all identifiers used in the tests are tokens of this text
+static char fixture_text[] = "a b c";
+
+Token_List *fixture_tokens() {
+    Token_List *tokens = new_token_list();
+    tokenize(new_source(fixture_text, strlen(fixture_text)), tokens);
+    return tokens;
+}
+
+//symbols and tables of all tests are allocated from this arena
+static Arena *fixture_arena = NULL;
+
+Arena *arena() {
+    if (fixture_arena == NULL) {
+        fixture_arena = new_arena(ARENA_BLOCK_SIZE, ARENA_DEFAULT);
+    }
+    return fixture_arena;
+}
+
 Symbol_Table *empty_table() {
-    return new_symbol_table();
+    return new_symbol_table(fixture_tokens(), arena());
 }
 
+//token_content is one of the identifiers in fixture_text
 Symbol *symbol_ident(char *token_content) {
-    Token *a_tk = new_token(TK_IDENT, token_content, strlen(token_content));
-    return new_symbol(SYM_INT, a_tk);
+    int token = strstr(fixture_text, token_content) - fixture_text;
+    return new_symbol(arena(), SYM_INT, token / 2);
 }
 
 Symbol_Table *populated_table() {
@@ -29,6 +54,77 @@ Symbol_Table *populated_table() {
     return table;
 }
 
+//program with many top-level functions that use globals, nested functions and conditions
+//if late_global is set, the first function uses a global that is only defined at the end
+char *generate_analysis_program(int function_count, int late_global, long *size) {
+    char *text = malloc(function_count * 256 + 256);
+    long pos = sprintf(text, "g0 = 1\n");
+    for (int i = 0; i < function_count; i++) {
+        pos += sprintf(text + pos, "function f%d {\n    a = g%d + %d\n", i, i / 50, i);
+        if (i == 0 && late_global) {
+            pos += sprintf(text + pos, "    a = late\n");
+        }
+        pos += sprintf(text + pos, "    function h {\n        if (a == 2) { b = a } else { h() }\n    }\n");
+        pos += sprintf(text + pos, "    if (a != 1) { h() } else { c = a + g0 }\n");
+        if (i > 0) {
+            pos += sprintf(text + pos, "    f%d()\n", i - 1);
+        }
+        pos += sprintf(text + pos, "}\n");
+        if (i % 50 == 49) {
+            pos += sprintf(text + pos, "g%d = %d\n", (i + 1) / 50, i);
+        }
+        if (i % 7 == 0) {
+            pos += sprintf(text + pos, "if (g0 == %d) { f%d() }\n", i, i);
+        }
+    }
+    pos += sprintf(text + pos, "late = 1\n");
+    *size = pos;
+    return text;
+}
+
+Flat_AST *analysis_ast(char *text, long size, Token_List *tokens) {
+    tokenize(new_source(text, size), tokens);
+    return flatten_ast(parse(tokens, arena()), tokens);
+}
+
+//actual has exactly the same scopes and resolutions as expected
+int assert_same_analysis(Flat_AST *ast, Symbol_Table *expected, Symbol_Table *actual) {
+    int err;
+    err = assert_int(actual->scope_count, expected->scope_count);
+    if (err) return err;
+    for (int i = 0; i < expected->scope_count; i++) {
+        Scope *expected_scope = symbol_table_scope(expected, i);
+        Scope *actual_scope = symbol_table_scope(actual, i);
+        err = assert_int(actual_scope->parent, expected_scope->parent);
+        if (err) return err;
+        err = assert_int(actual_scope->next_sibling, expected_scope->next_sibling);
+        if (err) return err;
+        err = assert_int(actual_scope->child_count, expected_scope->child_count);
+        if (err) return err;
+        err = assert_int(actual_scope->symbol_count, expected_scope->symbol_count);
+        if (err) return err;
+    }
+    for (int node = 0; node < ast->count; node++) {
+        err = assert_int(resolved_scope(actual, node), resolved_scope(expected, node));
+        if (err) return err;
+        Symbol *expected_symbol = resolved_symbol(expected, node);
+        Symbol *actual_symbol = resolved_symbol(actual, node);
+        if (expected_symbol == NULL) {
+            err = assert(actual_symbol, NULL);
+            if (err) return err;
+            continue;
+        }
+        err = assert_not(actual_symbol, NULL);
+        if (err) return err;
+        err = assert_int(actual_symbol->name, expected_symbol->name);
+        if (err) return err;
+        err = assert_int(actual_symbol->scope, expected_symbol->scope);
+        if (err) return err;
+    }
+
+    return 0;
+}
+
 //Tests
 
 int test_set_get() {
@@ -179,6 +275,335 @@ int test_symbol_table_is_local() {
     return 0;
 }
 
+//enough symbols in one scope to grow its map several times
+int test_many_symbols() {
+    int err;
+    int count = 10000;
+    char *text = malloc(count * 8);
+    int pos = 0;
+    for (int i = 0; i < count; i++) {
+        pos += sprintf(text + pos, "v%d ", i);
+    }
+    Token_List *tokens = new_token_list();
+    tokenize(new_source(text, pos), tokens);
+    Symbol_Table *table = new_symbol_table(tokens, arena());
+
+    for (int i = 0; i < count; i++) {
+        symbol_table_set(table, new_symbol(arena(), SYM_INT, i));
+    }
+    //redefinition does not replace the first symbol
+    symbol_table_set(table, new_symbol(arena(), SYM_FUNC, 0));
+
+    for (int i = 0; i < count; i++) {
+        Symbol *symbol = symbol_table_get(table, i);
+        err = assert_not(symbol, NULL);
+        if (err) return err;
+        err = assert_int(symbol->name, i);
+        if (err) return err;
+        err = assert_int(symbol->type, SYM_INT);
+        if (err) return err;
+    }
+    err = assert(scope_get_symbol(symbol_table_scope(table, ROOT_SCOPE), count), NULL);
+    if (err) return err;
+
+    //symbols keep their order of definition
+    Collection_Container *container = symbol_table_scope(table, ROOT_SCOPE)->symbols->root;
+    for (int i = 0; i < count; i++) {
+        err = assert_int(((Symbol *) container->item)->name, i);
+        if (err) return err;
+        container = container->next;
+    }
+
+    return 0;
+}
+
+//semantic analysis has to resolve every name, so codegen does not have to look anything up
+int test_resolved_names() {
+    int err;
+    char text[] = "a = 1\nfunction f {\n    b = a\n    f()\n}\nf()";
+    Token_List *tokens = new_token_list();
+    tokenize(new_source(text, strlen(text)), tokens);
+    Flat_AST *ast = flatten_ast(parse(tokens, arena()), tokens);
+    Symbol_Table *table = new_symbol_table(tokens, arena());
+    err = assert_int(semantic_analysis(ast, table), 0);
+    if (err) return err;
+
+    for (int node = 0; node < ast->count; node++) {
+        AST_Node_Type kind = flat_kind(ast, node);
+        int named = kind == ND_VAR || kind == ND_ASSIGN || kind == ND_FUNCTION_CALL || kind == ND_FUNCTION_DEF;
+        err = assert_int(resolved_symbol(table, node) != NULL, named);
+        if (err) return err;
+    }
+
+    //root, assign (var a, int), function_def f (assign (var b, var a), call f), call f
+    Symbol *a = resolved_symbol(table, 1);
+    err = assert(resolved_symbol(table, 2), a);
+    if (err) return err;
+    err = assert(resolved_symbol(table, 7), a);
+    if (err) return err;
+    err = assert_int(resolved_is_local(table, 7), FALSE);
+    if (err) return err;
+    err = assert_int(resolved_is_local(table, 5), TRUE);
+    if (err) return err;
+
+    //f calls itself from its own body (not local) and is called from the root scope (local)
+    Symbol *f = resolved_symbol(table, 4);
+    err = assert(resolved_symbol(table, 8), f);
+    if (err) return err;
+    err = assert_int(resolved_is_local(table, 8), FALSE);
+    if (err) return err;
+    err = assert(resolved_symbol(table, 9), f);
+    if (err) return err;
+    err = assert_int(resolved_is_local(table, 9), TRUE);
+    if (err) return err;
+
+    return 0;
+}
+
+//scopes form a tree of indices in pre-order and every node knows the scope it is in
+int test_scope_tree() {
+    int err;
+    char text[] = "if (1 == 1) { a = 1 } else { b = 2 }\nfunction f {\n    if (1 == 1) { c = 3 }\n}";
+    Token_List *tokens = new_token_list();
+    tokenize(new_source(text, strlen(text)), tokens);
+    Flat_AST *ast = flatten_ast(parse(tokens, arena()), tokens);
+    Symbol_Table *table = new_symbol_table(tokens, arena());
+    err = assert_int(semantic_analysis(ast, table), 0);
+    if (err) return err;
+
+    //root, true case, false case, body of f, true case inside of f
+    err = assert_int(table->scope_count, 5);
+    if (err) return err;
+    Scope *root = symbol_table_scope(table, ROOT_SCOPE);
+    err = assert_int(root->child_count, 3);
+    if (err) return err;
+    err = assert_int(root->first_child, 1);
+    if (err) return err;
+    err = assert_int(symbol_table_scope(table, 1)->next_sibling, 2);
+    if (err) return err;
+    err = assert_int(symbol_table_scope(table, 2)->next_sibling, 3);
+    if (err) return err;
+    err = assert_int(symbol_table_scope(table, 3)->next_sibling, NO_SCOPE);
+    if (err) return err;
+    err = assert_int(symbol_table_scope(table, 4)->parent, 3);
+    if (err) return err;
+
+    //root, cond (bool (int, int), true (assign (var a, int)), false (assign (var b, int))),
+    //function_def f (cond (bool (int, int), true (assign (var c, int))))
+    err = assert_int(resolved_scope(table, 0), ROOT_SCOPE);
+    if (err) return err;
+    err = assert_int(resolved_scope(table, 1), ROOT_SCOPE);
+    if (err) return err;
+    err = assert_int(resolved_scope(table, 5), 1);
+    if (err) return err;
+    err = assert_int(resolved_scope(table, 7), 1);
+    if (err) return err;
+    err = assert_int(resolved_scope(table, 11), 2);
+    if (err) return err;
+    err = assert_int(resolved_scope(table, 13), ROOT_SCOPE);
+    if (err) return err;
+    err = assert_int(resolved_scope(table, 14), 3);
+    if (err) return err;
+    err = assert_int(resolved_scope(table, 20), 4);
+    if (err) return err;
+    err = assert_int(resolved_symbol(table, 20)->scope, 4);
+    if (err) return err;
+
+    //any scope can be entered directly
+    symbol_table_enter(table, resolved_scope(table, 20));
+    err = assert(symbol_table_get(table, ast->nodes[20].token), resolved_symbol(table, 20));
+    if (err) return err;
+    err = assert_not(symbol_table_get(table, ast->nodes[13].token), NULL);
+    if (err) return err;
+    err = assert(symbol_table_get(table, ast->nodes[7].token), NULL);
+    if (err) return err;
+
+    return 0;
+}
+
+//parallel analysis has to produce exactly the same scopes and resolutions as a serial one
+int test_parallel_analysis() {
+    int err;
+    long size;
+    char *text = generate_analysis_program(4000, FALSE, &size);
+    Token_List *tokens = new_token_list();
+    Flat_AST *ast = analysis_ast(text, size, tokens);
+    Symbol_Table *serial = new_symbol_table(tokens, arena());
+    err = assert_int(semantic_analysis(ast, serial), 0);
+    if (err) return err;
+    Thread_Pool *pool = new_thread_pool(4);
+    Symbol_Table *parallel = new_symbol_table(tokens, arena());
+    err = assert_int(semantic_analysis_parallel(ast, parallel, pool), 0);
+    free_thread_pool(pool);
+    if (err) return err;
+
+    err = assert_same_analysis(ast, serial, parallel);
+    if (err) return err;
+
+    return 0;
+}
+
+//function bodies only see the globals defined before the function, even though they are checked after all declarations
+int test_parallel_analysis_error() {
+    int err;
+    long size;
+    char *text = generate_analysis_program(4000, TRUE, &size);
+    Token_List *tokens = new_token_list();
+    Flat_AST *ast = analysis_ast(text, size, tokens);
+    Thread_Pool *pool = new_thread_pool(4);
+    err = assert_int(semantic_analysis_parallel(ast, new_symbol_table(tokens, arena()), pool), 1);
+    free_thread_pool(pool);
+    if (err) return err;
+
+    return 0;
+}
+
+//unchanged function bodies are restored from the analysis cache, the results have to match a full analysis
+int test_incremental_analysis() {
+    int err;
+    char directory[] = "/tmp/test_analysis_cache_XXXXXX";
+    err = assert_not(mkdtemp(directory), NULL);
+    if (err) return err;
+    long size;
+    char *text = generate_analysis_program(200, FALSE, &size);
+    //a global with the name of a local of every body from f150 on
+    char *changed = malloc(size + 16);
+    char *split = strstr(text, "function f150 {");
+    long prefix = split - text;
+    memcpy(changed, text, prefix);
+    long changed_size = prefix + sprintf(changed + prefix, "a = 1\n");
+    memcpy(changed + changed_size, split, size - prefix);
+    changed_size += size - prefix;
+
+    //cold cache, same cache, changed outer names
+    char *texts[] = { text, text, changed };
+    long sizes[] = { size, size, changed_size };
+    int expected_reused[] = { 0, 200, 150 };
+    for (int i = 0; i < 3; i++) {
+        Token_List *tokens = new_token_list();
+        Flat_AST *ast = analysis_ast(texts[i], sizes[i], tokens);
+        Symbol_Table *serial = new_symbol_table(tokens, arena());
+        err = assert_int(semantic_analysis(ast, serial), 0);
+        if (err) return err;
+
+        Analysis_Cache *cache = load_analysis_cache(directory);
+        Symbol_Table *incremental = new_symbol_table(tokens, arena());
+        int reused, analyzed;
+        err = assert_int(semantic_analysis_incremental(ast, incremental, cache, &reused, &analyzed), 0);
+        if (err) return err;
+        err = assert_int(reused, expected_reused[i]);
+        if (err) return err;
+        err = assert_int(analyzed, 200 - expected_reused[i]);
+        if (err) return err;
+        err = assert_same_analysis(ast, serial, incremental);
+        if (err) return err;
+        err = assert_int(store_analysis_cache(directory, cache), 0);
+        if (err) return err;
+        free_analysis_cache(cache);
+    }
+
+    //an entry that fails validation while it is restored is replaced by a fresh one, not kept for the next compilation
+    char path[64];
+    sprintf(path, "%s/analysis.cache", directory);
+    //symbol of the last resolution of the last entry (the call of f198 in f199): out of range, none (-1)
+    //and a variable instead of the function (its 4 symbols are followed by the dependencies g3, g0 and f198)
+    int corrupt_symbols[] = { INT_MAX, -1, 4 };
+    for (int c = 0; c < 3; c++) {
+        FILE *file = fopen(path, "r+");
+        Analysis_Cache_Header header;
+        err = assert_int(fread(&header, sizeof(header), 1, file), 1);
+        if (err) return err;
+        fseek(file, header.data_offset + (header.data_size - 1) * sizeof(int), SEEK_SET);
+        fwrite(&corrupt_symbols[c], sizeof(int), 1, file);
+        fclose(file);
+        int expected_after_corrupt[] = { 0, 200 };
+        for (int i = 0; i < 2; i++) {
+            Token_List *tokens = new_token_list();
+            Flat_AST *ast = analysis_ast(changed, changed_size, tokens);
+            Symbol_Table *serial = new_symbol_table(tokens, arena());
+            err = assert_int(semantic_analysis(ast, serial), 0);
+            if (err) return err;
+
+            Analysis_Cache *cache = load_analysis_cache(directory);
+            Symbol_Table *incremental = new_symbol_table(tokens, arena());
+            int reused, analyzed;
+            err = assert_int(semantic_analysis_incremental(ast, incremental, cache, &reused, &analyzed), 0);
+            if (err) return err;
+            err = assert_int(reused, expected_after_corrupt[i]);
+            if (err) return err;
+            err = assert_same_analysis(ast, serial, incremental);
+            if (err) return err;
+            err = assert_int(store_analysis_cache(directory, cache), 0);
+            if (err) return err;
+            free_analysis_cache(cache);
+        }
+    }
+
+    //errors are still found in reused bodies
+    char *broken = generate_analysis_program(200, TRUE, &size);
+    Token_List *tokens = new_token_list();
+    Flat_AST *ast = analysis_ast(broken, size, tokens);
+    Analysis_Cache *cache = load_analysis_cache(directory);
+    int reused, analyzed;
+    err = assert_int(semantic_analysis_incremental(ast, new_symbol_table(tokens, arena()), cache, &reused, &analyzed), 1);
+    if (err) return err;
+    free_analysis_cache(cache);
+
+    char command[64];
+    sprintf(command, "rm -rf %s", directory);
+    system(command);
+    return 0;
+}
+
+//a cache file with counts too large for the file (that would overflow the array sizes) is ignored, everything is analyzed
+int test_analysis_cache_counts() {
+    int err;
+    char directory[] = "/tmp/test_analysis_cache_XXXXXX";
+    err = assert_not(mkdtemp(directory), NULL);
+    if (err) return err;
+    long size;
+    char *text = generate_analysis_program(20, FALSE, &size);
+    Token_List *tokens = new_token_list();
+    Flat_AST *ast = analysis_ast(text, size, tokens);
+    int reused, analyzed;
+    Analysis_Cache *cache = load_analysis_cache(directory);
+    err = assert_int(semantic_analysis_incremental(ast, new_symbol_table(tokens, arena()), cache, &reused, &analyzed), 0);
+    if (err) return err;
+    err = assert_int(store_analysis_cache(directory, cache), 0);
+    if (err) return err;
+    free_analysis_cache(cache);
+
+    char path[64];
+    sprintf(path, "%s/analysis.cache", directory);
+    FILE *file = fopen(path, "r+");
+    Analysis_Cache_Header header;
+    err = assert_int(fread(&header, sizeof(header), 1, file), 1);
+    if (err) return err;
+    //entry count larger than the file, data size that wraps around when multiplied by the size of an int
+    Analysis_Cache_Header corrupt[2] = { header, header };
+    corrupt[0].entry_count = UINT_MAX;
+    corrupt[1].data_size = (1ull << 62) + header.data_size;
+    for (int i = 0; i < 2; i++) {
+        rewind(file);
+        fwrite(&corrupt[i], sizeof(header), 1, file);
+        fflush(file);
+        cache = load_analysis_cache(directory);
+        err = assert_int(semantic_analysis_incremental(ast, new_symbol_table(tokens, arena()), cache, &reused, &analyzed), 0);
+        if (err) return err;
+        err = assert_int(reused, 0);
+        if (err) return err;
+        err = assert_int(analyzed, 20);
+        if (err) return err;
+        free_analysis_cache(cache);
+    }
+    fclose(file);
+
+    char command[64];
+    sprintf(command, "rm -rf %s", directory);
+    system(command);
+    return 0;
+}
+
 int main() {
     gather_tests(
         test_set_get,
@@ -188,6 +613,13 @@ int main() {
         test_walk_child,
         test_walk_next,
         test_symbol_table_is_local,
+        test_many_symbols,
+        test_resolved_names,
+        test_scope_tree,
+        test_parallel_analysis,
+        test_parallel_analysis_error,
+        test_incremental_analysis,
+        test_analysis_cache_counts,
         NULL
     );
 }